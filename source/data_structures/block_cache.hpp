@@ -0,0 +1,126 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+// Bounded LRU cache of data blocks, keyed by block index.
+//
+// The cache is split into independently locked shards (block % shards), so
+// concurrent readers of different blocks rarely contend and there is no
+// global lock. It is write-through: the owner writes the block to disk and
+// then calls put()/invalidate(), so the disk copy is always current and
+// entries can be dropped at any time.
+class BlockCache {
+    struct Shard {
+        mutex lock;
+        list<pair<uint32_t, vector<char>>> lru;   // front = most recently used
+        unordered_map<uint32_t, list<pair<uint32_t, vector<char>>>::iterator> index;
+    };
+
+    vector<unique_ptr<Shard>> shards;
+    size_t perShardCapacity = 0;
+    atomic<uint64_t> hits{0};
+    atomic<uint64_t> misses{0};
+
+    Shard& shardFor(uint32_t block) { return *shards[block % shards.size()]; }
+
+public:
+    BlockCache(size_t capacityBlocks = 0, size_t shardCount = 16) {
+        configure(capacityBlocks, shardCount);
+    }
+
+    // Drops all entries and resizes. A capacity of 0 disables the cache.
+    void configure(size_t capacityBlocks, size_t shardCount = 16) {
+        shardCount = max<size_t>(1, shardCount);
+        shards.clear();
+        for (size_t i = 0; i < shardCount; ++i)
+            shards.push_back(make_unique<Shard>());
+        perShardCapacity = (capacityBlocks + shardCount - 1) / shardCount;
+        hits = 0;
+        misses = 0;
+    }
+
+    bool enabled() const { return perShardCapacity > 0; }
+
+    bool get(uint32_t block, vector<char>& out) {
+        if (!enabled()) return false;
+        Shard& s = shardFor(block);
+        lock_guard<mutex> g(s.lock);
+
+        auto it = s.index.find(block);
+        if (it == s.index.end()) {
+            ++misses;
+            return false;
+        }
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        out = it->second->second;
+        ++hits;
+        return true;
+    }
+
+    void put(uint32_t block, const char* data, size_t len) {
+        if (!enabled()) return;
+        Shard& s = shardFor(block);
+        lock_guard<mutex> g(s.lock);
+
+        auto it = s.index.find(block);
+        if (it != s.index.end()) {
+            it->second->second.assign(data, data + len);
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            return;
+        }
+
+        if (s.lru.size() >= perShardCapacity) {
+            s.index.erase(s.lru.back().first);
+            s.lru.pop_back();
+        }
+        s.lru.emplace_front(block, vector<char>(data, data + len));
+        s.index[block] = s.lru.begin();
+    }
+
+    void invalidate(uint32_t block) {
+        if (!enabled()) return;
+        Shard& s = shardFor(block);
+        lock_guard<mutex> g(s.lock);
+
+        auto it = s.index.find(block);
+        if (it == s.index.end()) return;
+        s.lru.erase(it->second);
+        s.index.erase(it);
+    }
+
+    void invalidateRange(uint32_t first, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i)
+            invalidate(first + i);
+    }
+
+    void clear() {
+        for (auto& s : shards) {
+            lock_guard<mutex> g(s->lock);
+            s->lru.clear();
+            s->index.clear();
+        }
+    }
+
+    uint64_t hitCount() const { return hits; }
+    uint64_t missCount() const { return misses; }
+
+    size_t size() {
+        size_t n = 0;
+        for (auto& s : shards) {
+            lock_guard<mutex> g(s->lock);
+            n += s->lru.size();
+        }
+        return n;
+    }
+
+    size_t capacity() const { return perShardCapacity * shards.size(); }
+};
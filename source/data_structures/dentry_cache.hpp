@@ -0,0 +1,156 @@
+#pragma once
+#include <vector>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+struct FileNode;
+
+// Bounded LRU cache of resolved paths: canonical absolute path -> FileNode,
+// or nullptr for a path known not to exist (negative entry).
+//
+// Sharded like BlockCache (hash(path) % shards) so concurrent lookups of
+// different paths rarely contend. DirectoryTree owns the invalidation:
+//   - creating a node drops the negative entry for its path
+//   - deleting a file drops its path; deleting (or renaming) a directory
+//     drops every entry under it
+// and clear() runs whenever the whole tree is rebuilt.
+class DentryCache {
+    using Entry = pair<string, FileNode*>;
+
+    struct Shard {
+        mutex lock;
+        list<Entry> lru;   // front = most recently used
+        unordered_map<string, list<Entry>::iterator> index;
+    };
+
+    vector<unique_ptr<Shard>> shards;
+    size_t perShardCapacity = 0;
+    atomic<uint64_t> hits{0};
+    atomic<uint64_t> negativeHits{0};
+    atomic<uint64_t> misses{0};
+    atomic<uint64_t> invalidations{0};
+
+    Shard& shardFor(const string& path) { return *shards[hash<string>()(path) % shards.size()]; }
+
+    static bool under(const string& path, const string& dir) {
+        return path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0 &&
+               (dir == "/" || path[dir.size()] == '/');
+    }
+
+public:
+    DentryCache(size_t capacity = 0, size_t shardCount = 16) { configure(capacity, shardCount); }
+
+    // Drops all entries and resizes. A capacity of 0 disables the cache.
+    void configure(size_t capacity, size_t shardCount = 16) {
+        shardCount = max<size_t>(1, shardCount);
+        shards.clear();
+        for (size_t i = 0; i < shardCount; ++i)
+            shards.push_back(make_unique<Shard>());
+        perShardCapacity = (capacity + shardCount - 1) / shardCount;
+        hits = negativeHits = misses = invalidations = 0;
+    }
+
+    bool enabled() const { return perShardCapacity > 0; }
+
+    // True when path is cached; node is then the cached result (nullptr for
+    // a negative entry).
+    bool get(const string& path, FileNode*& node) {
+        if (!enabled()) return false;
+        Shard& s = shardFor(path);
+        lock_guard<mutex> g(s.lock);
+
+        auto it = s.index.find(path);
+        if (it == s.index.end()) {
+            ++misses;
+            return false;
+        }
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        node = it->second->second;
+        ++(node ? hits : negativeHits);
+        return true;
+    }
+
+    void put(const string& path, FileNode* node) {
+        if (!enabled()) return;
+        Shard& s = shardFor(path);
+        lock_guard<mutex> g(s.lock);
+
+        auto it = s.index.find(path);
+        if (it != s.index.end()) {
+            it->second->second = node;
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            return;
+        }
+
+        if (s.lru.size() >= perShardCapacity) {
+            s.index.erase(s.lru.back().first);
+            s.lru.pop_back();
+        }
+        s.lru.emplace_front(path, node);
+        s.index[path] = s.lru.begin();
+    }
+
+    void invalidate(const string& path) {
+        if (!enabled()) return;
+        Shard& s = shardFor(path);
+        lock_guard<mutex> g(s.lock);
+
+        auto it = s.index.find(path);
+        if (it == s.index.end()) return;
+        s.lru.erase(it->second);
+        s.index.erase(it);
+        ++invalidations;
+    }
+
+    // Drops path and everything below it. Walks every shard, so it is kept
+    // for directory deletes and renames.
+    void invalidateTree(const string& dir) {
+        invalidate(dir);
+        if (!enabled()) return;
+        for (auto& s : shards) {
+            lock_guard<mutex> g(s->lock);
+            for (auto it = s->lru.begin(); it != s->lru.end();) {
+                if (under(it->first, dir)) {
+                    s->index.erase(it->first);
+                    it = s->lru.erase(it);
+                    ++invalidations;
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    void clear() {
+        for (auto& s : shards) {
+            lock_guard<mutex> g(s->lock);
+            s->lru.clear();
+            s->index.clear();
+        }
+    }
+
+    uint64_t hitCount() const { return hits; }
+    uint64_t negativeHitCount() const { return negativeHits; }
+    uint64_t missCount() const { return misses; }
+    uint64_t invalidationCount() const { return invalidations; }
+
+    size_t size() {
+        size_t n = 0;
+        for (auto& s : shards) {
+            lock_guard<mutex> g(s->lock);
+            n += s->lru.size();
+        }
+        return n;
+    }
+
+    size_t capacity() const { return perShardCapacity * shards.size(); }
+};
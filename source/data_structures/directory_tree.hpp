@@ -4,28 +4,428 @@
 #include<sstream>
 #include<algorithm>
 #include<vector>
+#include<memory>
+#include<string_view>
+#include<functional>
+#include<thread>
+#include<chrono>
+#include<atomic>
+#include<mutex>
 
 
 #include "../include/core/odf_types.hpp"
+#include "dentry_cache.hpp"
+#include "node_arena.hpp"
+#include "tree_search.hpp"
 
 
 using namespace std;
 
+// Running totals over the tree, kept in step with every node insert/delete so
+// statistics never need a walk.
+struct TreeCounts {
+    uint32_t files = 0;
+    uint32_t directories = 0;        // excluding root
+    uint64_t extents = 0;            // data runs over all files
+    uint32_t fragmentedFiles = 0;    // files stored in more than one run
+};
+
+// Directories with more children than this get a hash index over them.
+static constexpr size_t K_CHILD_INDEX_THRESHOLD = 32;
+
+// Fewest entries per import thread; smaller tables load serially.
+static constexpr size_t K_IMPORT_ENTRIES_PER_THREAD = 16384;
+
+// find(): fewest nodes per search thread, children per task (larger
+// directories are split), matches per batch handed to the sink, and the
+// matches or milliseconds after which a round pauses.
+static constexpr size_t K_SEARCH_NODES_PER_THREAD = 16384;
+static constexpr size_t K_FIND_SLICE = 4096;
+static constexpr size_t K_FIND_BATCH = 256;
+static constexpr size_t K_FIND_ROUND = 4096;
+static constexpr int K_FIND_ROUND_MS = 5;
+
+// Wall time of each importFromEntries() phase, in milliseconds.
+struct ImportTimings {
+    double parse = 0;       // name lengths and hashes, per-parent link lists (parallel)
+    double create = 0;      // nodes and interned names (serial)
+    double link = 0;        // children under their parents (parallel, by parent)
+    double verify = 0;      // reachability, counts, free inode list
+    unsigned threads = 1;
+};
+
+// An entry read back by a lazy page-in, with the run count of its data.
+struct PagedEntry {
+    FileEntry entry;
+    uint32_t extents;
+};
+
+// Nodes come from the tree's SlabPool and names from its NameTable, so a
+// node is one slab slot plus its children array. A node holds metadata and
+// the data root only; file content stays on disk (OFSCore::readData).
 struct FileNode {
-    string name;
-    bool isFile;
+    string_view name;           // interned in DirectoryTree::names
     FileNode* parent;
-    string data;
-    vector<FileNode*> children;
+    PtrList<FileNode> children;
+    uint64_t size = 0;          // Logical file size in bytes
+    Extent blocks{0, 0};        // Data root on disk (encoding in odf_types.hpp)
+    uint32_t inode = 0;         // Stable inode number (FileEntry slot + 1), 0 = none
+    uint32_t extents = 0;       // Data runs behind `blocks` (0 = no data)
+    uint32_t childPos = 0;      // position in parent->children (indexed parents)
+    uint32_t childSeq = 0;      // insertion order among siblings
+    uint32_t nextChildSeq = 0;
+    uint32_t lastUse = 0;       // lazy mode: tick of the last lookup through this directory
+    bool isFile;
+    bool loaded = true;         // lazy mode: false until the children are paged in
+
+    // Name -> child, built once a directory outgrows K_CHILD_INDEX_THRESHOLD.
+    // A file and a directory may share a name; the older one wins.
+    unique_ptr<ChildTable<FileNode>> childIndex;
 
-    FileNode(const string& _name, bool _isFile, FileNode* _parent = nullptr)
-        : name(_name), isFile(_isFile), parent(_parent) {}
+    FileNode(string_view _name, bool _isFile, FileNode* _parent = nullptr)
+        : name(_name), parent(_parent), isFile(_isFile) {}
+};
+
+// Resolved-once reference to a node. The generation changes whenever the
+// inode is freed, so a handle to a deleted node never reaches the node
+// that later reuses its number.
+struct FileHandle {
+    uint32_t inode = 0;
+    uint32_t generation = 0;
+
+    bool valid() const { return inode != 0; }
+};
+
+// Where a paused DirectoryTree::find() resumes: the directory slices not
+// searched yet. Directories are held by handle, so the tree may change
+// between rounds. One deleted meanwhile is skipped, and entries added or
+// removed in a directory mid-search may be missed or seen twice.
+struct FindCursor {
+    struct Task {
+        FileHandle dir;                 // inode 0 = root
+        size_t begin, end;
+    };
+    vector<Task> tasks;
+    size_t emitted = 0;                 // matches handed out so far
+
+    bool done() const { return tasks.empty(); }
 };
 
 class DirectoryTree {
 
     FileNode* root;
 
+    // Inode table. Every node except root owns an inode, and inode i is
+    // persisted in FileEntry slot i - 1 of the metadata region, so numbers
+    // survive restarts. Mutations mark slots dirty so only changed entries
+    // are rewritten.
+    size_t slotCapacity = 512;
+    vector<FileNode*> inodeTable;       // inode - 1 -> node (nullptr = free)
+    vector<uint32_t> generations;       // inode - 1 -> times the inode was freed
+    vector<uint32_t> freeInodes;        // free inodes, lowest last
+    vector<char> slotDirty;
+    vector<int32_t> dirtySlots;
+    uint32_t highWater = 0;             // highest inode bound since the last reset
+
+    // Path index keys added (true) or removed since the last collect, kept
+    // only while an on-disk index is being maintained.
+    bool indexKeys = false;
+    vector<pair<bool, IndexKey>> keyChanges;
+
+    static int32_t slotOf(uint32_t inode) { return static_cast<int32_t>(inode) - 1; }
+
+    static IndexKey indexKey(uint32_t parentInode, string_view name, uint32_t inode) {
+        return {parentInode, inode, indexNameHash(name.data(), name.size())};
+    }
+
+    void noteKey(bool added, const FileNode* node) {
+        if (indexKeys && node->inode)
+            keyChanges.emplace_back(added, indexKey(node->parent ? node->parent->inode : 0, node->name, node->inode));
+    }
+
+    TreeCounts tally;
+    DentryCache dentries{4096};
+    unsigned importThreads = 0;         // 0 = one per core
+    unsigned searchThreads = 0;         // 0 = one per core
+    ImportTimings timings;
+
+    // Lazy mode (startLazy): directories page their children in from disk
+    // on first use, and cold ones drop them again (evictCold).
+    bool lazy = false;
+    uint32_t useClock = 0;
+    uint64_t pageIns = 0;
+    uint64_t evictions = 0;
+
+    SlabPool<FileNode> nodes;
+    NameTable names;
+
+    FileNode* makeNode(string_view name, bool isFile, FileNode* parent) {
+        return nodes.make(names.intern(name), isFile, parent);
+    }
+
+    void countNode(const FileNode* node, int delta) {
+        if (node == root) return;
+        if (!node->isFile) {
+            tally.directories += delta;
+            return;
+        }
+        tally.files += delta;
+        tally.extents += static_cast<int64_t>(delta) * node->extents;
+        if (node->extents > 1) tally.fragmentedFiles += delta;
+    }
+
+    // First child named `name` in children order; dirsOnly skips files.
+    // O(1) expected on indexed directories, a scan on small ones.
+    static FileNode* findChild(const FileNode* dir, string_view name, bool dirsOnly) {
+        if (!dir->childIndex) {
+            for (FileNode* c : dir->children)
+                if (c->name == name && !(dirsOnly && c->isFile)) return c;
+            return nullptr;
+        }
+        return dir->childIndex->find(name, [dirsOnly](const FileNode* c) {
+            return !(dirsOnly && c->isFile);
+        });
+    }
+
+    static void buildChildIndex(FileNode* dir) {
+        dir->childIndex.reset(new ChildTable<FileNode>(dir->children.size()));
+        for (size_t i = 0; i < dir->children.size(); ++i) {
+            FileNode* c = dir->children[i];
+            c->childPos = static_cast<uint32_t>(i);
+            dir->childIndex->insert(c);
+        }
+    }
+
+    // Appends node to parent's children (and index, if any).
+    static void linkChild(FileNode* parent, FileNode* node) {
+        node->parent = parent;
+        node->childSeq = parent->nextChildSeq++;
+        node->childPos = static_cast<uint32_t>(parent->children.size());
+        parent->children.push_back(node);
+        if (parent->childIndex)
+            parent->childIndex->insert(node);
+        else if (parent->children.size() > K_CHILD_INDEX_THRESHOLD)
+            buildChildIndex(parent);
+    }
+
+    FileNode* addChild(FileNode* parent, string_view name, bool isFile) {
+        FileNode* node = makeNode(name, isFile, parent);
+        linkChild(parent, node);
+        countNode(node, +1);
+        if (dentries.enabled()) dentries.invalidate(pathOf(node));  // negative entry
+        return node;
+    }
+
+    // Removes node from its parent's children. Indexed directories swap the
+    // last child into the hole (O(1)); listings sort, and duplicate names
+    // resolve by childSeq, so order is not needed there.
+    static void detachChild(FileNode* node) {
+        FileNode* parent = node->parent;
+        auto& siblings = parent->children;
+        if (!parent->childIndex) {
+            siblings.erase(node);
+            return;
+        }
+        parent->childIndex->erase(node);
+        FileNode* moved = siblings.back();
+        siblings[node->childPos] = moved;
+        moved->childPos = node->childPos;
+        siblings.pop_back();
+    }
+
+    void markDirty(int32_t slot) {
+        if (slot < 0 || slotDirty[slot]) return;
+        slotDirty[slot] = 1;
+        dirtySlots.push_back(slot);
+    }
+
+    void resetSlots() {
+        inodeTable.assign(slotCapacity, nullptr);
+        generations.assign(slotCapacity, 0);
+        slotDirty.assign(slotCapacity, 0);
+        dirtySlots.clear();
+        freeInodes.clear();
+        highWater = 0;
+        for (size_t i = slotCapacity; i > 0; --i)
+            freeInodes.push_back(static_cast<uint32_t>(i));
+    }
+
+    // Appends n slots; their inodes are higher than any free one, so they
+    // go to the front of the lowest-last free list.
+    void extendSlots(size_t n) {
+        const size_t old = slotCapacity;
+        slotCapacity += n;
+        inodeTable.resize(slotCapacity, nullptr);
+        generations.resize(slotCapacity, 0);
+        slotDirty.resize(slotCapacity, 0);
+        vector<uint32_t> added;
+        added.reserve(n);
+        for (size_t i = slotCapacity; i > old; --i)
+            added.push_back(static_cast<uint32_t>(i));
+        freeInodes.insert(freeInodes.begin(), added.begin(), added.end());
+    }
+
+    void bindInode(FileNode* node, uint32_t inode) {
+        node->inode = inode;
+        inodeTable[slotOf(inode)] = node;
+        highWater = max(highWater, inode);
+    }
+
+    // Gives node the lowest free inode. Entries refer to their parent by
+    // inode, so a node under an unpersisted directory is not persisted
+    // either.
+    void allocInode(FileNode* node) {
+        if (freeInodes.empty() && growSlots) {
+            if (size_t n = growSlots()) extendSlots(n);
+        }
+        if (freeInodes.empty() || (node->parent != root && node->parent->inode == 0)) {
+            cerr << "⚠️ Metadata table full, '" << node->name << "' will not be persisted.\n";
+            return;
+        }
+        bindInode(node, freeInodes.back());
+        freeInodes.pop_back();
+        markDirty(slotOf(node->inode));
+        noteKey(true, node);
+    }
+
+    // Frees the inodes of a subtree; their entries are written as zeros.
+    void releaseInodes(FileNode* node) {
+        if (!node) return;
+        for (auto* child : node->children)
+            releaseInodes(child);
+        if (node->inode == 0) return;
+        noteKey(false, node);
+        const int32_t slot = slotOf(node->inode);
+        inodeTable[slot] = nullptr;
+        ++generations[slot];
+        freeInodes.push_back(node->inode);
+        markDirty(slot);
+        node->inode = 0;
+    }
+
+    // Detaches a node from its parent and frees its whole subtree. In lazy
+    // mode the subtree is paged in first, so every inode in it is freed.
+    bool unlinkNode(FileNode* node) {
+        if (lazy && !loadSubtree(node)) return false;
+        if (dentries.enabled()) {
+            if (node->isFile) dentries.invalidate(pathOf(node));
+            else dentries.invalidateTree(pathOf(node));
+        }
+        detachChild(node);
+        releaseInodes(node);
+        deleteNodeRec(node);
+        return true;
+    }
+
+    // Lazy mode: pages in dir's children on first use. They are linked in
+    // inode order, as importFromEntries does, so a file and a directory
+    // sharing a name resolve the same way after a full load.
+    bool ensureLoaded(FileNode* dir) {
+        if (dir->isFile) return true;
+        dir->lastUse = ++useClock;
+        if (dir->loaded) return true;
+
+        vector<PagedEntry> found;
+        if (!pageIn || !pageIn(dir->inode, found)) {
+            cerr << "❌ Could not page in " << pathOf(dir) << endl;
+            return false;
+        }
+        sort(found.begin(), found.end(),
+             [](const PagedEntry& a, const PagedEntry& b) { return a.entry.inode < b.entry.inode; });
+        dir->children.reserve(found.size());
+        for (const PagedEntry& p : found) {
+            const FileEntry& e = p.entry;
+            if (e.inode == 0 || e.inode > slotCapacity || inodeTable[slotOf(e.inode)]) continue;
+            FileNode* node = makeNode(string_view(e.name, strnlen(e.name, sizeof(e.name))), e.type != 1, nullptr);
+            if (node->isFile) {
+                node->size = e.size;
+                node->blocks = {e.start_block, e.block_count};
+                node->extents = p.extents;
+            } else {
+                node->loaded = false;
+            }
+            bindInode(node, e.inode);
+            linkChild(dir, node);
+        }
+        dir->loaded = true;
+        ++pageIns;
+        return true;
+    }
+
+    // node, paged in if it is a directory; nullptr if that fails.
+    FileNode* pagedIn(FileNode* node) {
+        return !node || !lazy || ensureLoaded(node) ? node : nullptr;
+    }
+
+    bool loadSubtree(FileNode* top) {
+        vector<FileNode*> pending{top};
+        while (!pending.empty()) {
+            FileNode* d = pending.back();
+            pending.pop_back();
+            if (!ensureLoaded(d)) return false;
+            for (FileNode* c : d->children)
+                if (!c->isFile) pending.push_back(c);
+        }
+        return true;
+    }
+
+    // Drops the children of a directory whose subdirectories are all
+    // unloaded. The children keep their inodes and generations; only the
+    // nodes go. Unpersisted nodes (inode 0) pin their directory.
+    bool unloadDir(FileNode* dir) {
+        if (dir->inode == 0) return false;
+        for (FileNode* c : dir->children)
+            if (c->inode == 0 || (!c->isFile && c->loaded)) return false;
+        for (FileNode* c : dir->children) {
+            inodeTable[slotOf(c->inode)] = nullptr;
+            names.release(c->name);
+            nodes.destroy(c);
+        }
+        dir->children.clear();
+        dir->childIndex.reset();
+        dir->loaded = false;
+        ++evictions;
+        return true;
+    }
+
+    // Lazy mode: the node behind an inode that is not resident, found by
+    // reading parent entries up to a resident directory and paging each
+    // one in on the way back down.
+    FileNode* loadInode(uint32_t inode) {
+        vector<uint32_t> chain;
+        uint32_t cur = inode;
+        while (cur && !nodeByInode(cur)) {
+            FileEntry e{};
+            if (cur > slotCapacity || chain.size() > slotCapacity || !readEntry || !readEntry(cur, e) ||
+                e.inode != cur || e.name[0] == '\0')
+                return nullptr;
+            chain.push_back(cur);
+            cur = e.parent_inode;
+        }
+        FileNode* node = cur ? nodeByInode(cur) : root;
+        for (size_t i = chain.size(); i-- > 0;) {
+            if (node->isFile || !ensureLoaded(node)) return nullptr;
+            if (!(node = nodeByInode(chain[i]))) return nullptr;
+        }
+        return node;
+    }
+
+    // Parent-index entry: the node's own name plus its parent's inode.
+    static FileEntry makeEntry(const FileNode* node) {
+        FileEntry entry{};
+        memset(&entry, 0, sizeof(FileEntry));
+        memcpy(entry.name, node->name.data(), min(node->name.size(), sizeof(entry.name) - 1));
+        entry.type = node->isFile ? 0 : 1;
+        entry.size = node->isFile ? node->size : 0;
+        entry.permissions = 0644;
+        strncpy(entry.owner, "admin", sizeof(entry.owner) - 1);
+        entry.inode = node->inode;
+        entry.parent_inode = node->parent ? node->parent->inode : 0;
+        entry.start_block = node->blocks.start;
+        entry.block_count = node->blocks.count;
+        return entry;
+    }
+
     vector<string> splitDirectory(const string& path) {
         vector<string> result;
         string token;
@@ -40,35 +440,94 @@ class DirectoryTree {
         if (!node) return;
         for (auto* child : node->children)
             deleteNodeRec(child);
-        node->children.clear();
-        delete node;
+        countNode(node, -1);
+        names.release(node->name);
+        nodes.destroy(node);
+    }
+
+    // Whole-tree teardown: runs the destructors, then drops every slab and
+    // interned name at once instead of freeing node by node.
+    void destroyAll(FileNode* node) {
+        for (auto* child : node->children)
+            destroyAll(child);
+        node->~FileNode();
+    }
+
+    // Splits [0, n) into `threads` contiguous chunks and runs fn(t, begin,
+    // end) for each, chunk 0 on the calling thread.
+    template <typename Fn>
+    static void runParallel(unsigned threads, size_t n, Fn fn) {
+        vector<thread> workers;
+        for (unsigned t = 1; t < threads; ++t)
+            workers.emplace_back([&, t] { fn(t, n * t / threads, n * (t + 1) / threads); });
+        fn(0u, size_t(0), n / threads);
+        for (auto& w : workers) w.join();
+    }
+
+    unsigned importThreadsFor(size_t entries) const {
+        unsigned n = importThreads ? importThreads : thread::hardware_concurrency();
+        n = min<size_t>(max(1u, n), max<size_t>(1, entries / K_IMPORT_ENTRIES_PER_THREAD));
+        return max(1u, n);
     }
 
 public:
-    DirectoryTree() { root = new FileNode("root", false, nullptr); }
-    ~DirectoryTree() { deleteNodeRec(root); root = nullptr; }
+    // Called when every slot is taken; returns how many slots the metadata
+    // region grew by (0 = it cannot grow). Unset, the table stays fixed.
+    function<size_t()> growSlots;
 
+    // Lazy mode: fills out with the entries whose parent is `inode` (0 =
+    // root), or returns false if they cannot be read.
+    function<bool(uint32_t, vector<PagedEntry>&)> pageIn;
+
+    // Lazy mode: reads the entry in inode's slot.
+    function<bool(uint32_t, FileEntry&)> readEntry;
+
+    DirectoryTree() {
+        root = makeNode("root", false, nullptr);
+        resetSlots();
+    }
+    ~DirectoryTree() { destroyAll(root); root = nullptr; }
+
+    // Canonical paths ("/a/b": leading slash, no empty components, no
+    // trailing slash) go through the dentry cache; others resolve uncached.
+    static bool canonicalPath(const string& path) {
+        if (path.size() < 2 || path[0] != '/' || path.back() == '/') return false;
+        return path.find("//") == string::npos;
+    }
+
+    // In lazy mode every directory on the way, and the one found, is paged
+    // in, so callers can use its children directly.
     FileNode* findNodeByPath(const string& path) {
         if (!root) return nullptr;
-        if (path == "/" || path.empty()) return root;
+        if (path == "/" || path.empty()) return pagedIn(root);
+
+        const bool cacheable = dentries.enabled() && canonicalPath(path);
+        FileNode* cached = nullptr;
+        if (cacheable && dentries.get(path, cached)) return pagedIn(cached);
 
-        vector<string> folders = splitDirectory(path);
+        // Walk the components in place, reusing one name buffer.
         FileNode* curr = root;
-        for (size_t i = 0; i < folders.size(); ++i) {
-            const string& folder = folders[i];
-            bool found = false;
-            for (FileNode* child : curr->children) {
-                if (child->name == folder && (i == folders.size() - 1 || !child->isFile)) {
-                    curr = child;
-                    found = true;
-                    break;
-                }
+        string part;
+        size_t pos = 0;
+        while (curr && pos < path.size()) {
+            size_t next = path.find('/', pos);
+            if (next == string::npos) next = path.size();
+            if (next > pos) {
+                if (lazy && !ensureLoaded(curr)) return nullptr;
+                part.assign(path, pos, next - pos);
+                bool last = path.find_first_not_of('/', next) == string::npos;
+                curr = findChild(curr, part, !last);
             }
-            if (!found) return nullptr;
+            pos = next + 1;
         }
+
+        if (curr && lazy && !ensureLoaded(curr)) return nullptr;
+        if (cacheable) dentries.put(path, curr);
         return curr;
     }
 
+    DentryCache& dentryCache() { return dentries; }
+
  bool createDirectory(const string& basePath, const string& relativePath) {
     if (relativePath.empty()) return false;
 
@@ -78,18 +537,12 @@ public:
 
     for (const string& part : parts) {
         if (part.empty()) continue;
+        if (lazy && !ensureLoaded(current)) return false;
 
-        FileNode* next = nullptr;
-        for (auto* c : current->children) {
-            if (!c->isFile && c->name == part) {
-                next = c;
-                break;
-            }
-        }
-
+        FileNode* next = findChild(current, part, true);
         if (!next) {
-            next = new FileNode(part, false, current);
-            current->children.push_back(next);
+            next = addChild(current, part, false);
+            allocInode(next);
         }
         current = next;
     }
@@ -98,22 +551,76 @@ public:
 }
 
 
-    bool createFile(const string& path, const string& name, const string& data) {
+    // Registers a file whose content is already on disk at `blocks`. The
+    // tree keeps only metadata; content is read back through the I/O layer.
+    bool createFile(const string& path, const string& name, uint64_t size,
+                    const Extent& blocks = {0, 0}, uint32_t extents = 0) {
         if (!root) return false;
 
         FileNode* parent = findNodeByPath(path);
         if (!parent || parent->isFile) return false;
 
-        for (FileNode* child : parent->children) {
-            if (child->name == name) {
-                cout << "⚠️ Name already in use: " << name << endl;
+        if (findChild(parent, name, false)) {
+            cout << "⚠️ Name already in use: " << name << endl;
+            return false;
+        }
+
+        FileNode* newFile = addChild(parent, name, true);
+        newFile->size = size;
+        newFile->blocks = blocks;
+        setExtentCount(newFile, extents);
+        allocInode(newFile);
+        return true;
+    }
+
+    // Moves the node at `from` to the full path `to`. Descendants refer to
+    // it by inode, so only the moved node's entry is rewritten.
+    bool renameNode(const string& from, const string& to) {
+        FileNode* node = findNodeByPath(from);
+        if (!node || node == root) {
+            cout << "❌ Not found: " << from << endl;
+            return false;
+        }
+
+        size_t pos = to.find_last_of('/');
+        if (pos == string::npos) return false;
+        string name = to.substr(pos + 1);
+        if (name.empty() || name.size() >= sizeof(FileEntry::name)) {
+            cout << "⚠️ Invalid name: " << to << endl;
+            return false;
+        }
+        FileNode* parent = findNodeByPath(pos ? to.substr(0, pos) : "/");
+        if (!parent || parent->isFile) {
+            cout << "❌ Target directory not found: " << to.substr(0, pos) << endl;
+            return false;
+        }
+        for (FileNode* p = parent; p; p = p->parent) {
+            if (p == node) {
+                cout << "⚠️ Cannot move a directory into itself.\n";
                 return false;
             }
         }
+        if (FileNode* clash = findChild(parent, name, false)) {
+            if (clash == node) return true;
+            cout << "⚠️ Name already in use: " << name << endl;
+            return false;
+        }
 
-        FileNode* newFile = new FileNode(name, true, parent);
-        newFile->data = data;
-        parent->children.push_back(newFile);
+        auto invalidate = [&] {
+            if (!dentries.enabled()) return;
+            if (node->isFile) dentries.invalidate(pathOf(node));
+            else dentries.invalidateTree(pathOf(node));
+        };
+        invalidate();
+        noteKey(false, node);
+        detachChild(node);
+        string_view oldName = node->name;
+        node->name = names.intern(name);
+        names.release(oldName);
+        linkChild(parent, node);
+        noteKey(true, node);
+        invalidate();  // negative entries under the new path
+        touch(node);
         return true;
     }
 
@@ -122,13 +629,9 @@ public:
         FileNode* n = findNodeByPath(path);
         if (!n || n == root) return false;
 
-        FileNode* parent = n->parent;
-        if (!parent) return false;
+        if (!n->parent) return false;
 
-        auto& siblings = parent->children;
-        siblings.erase(remove(siblings.begin(), siblings.end(), n), siblings.end());
-        deleteNodeRec(n);
-        return true;
+        return unlinkNode(n);
     }
 
 
@@ -157,12 +660,7 @@ bool deleteFile(const string& fullPath) {
         return false;
     }
 
-    FileNode* parent = node->parent;
-    if (!parent) return false;
-
-    auto& siblings = parent->children;
-    siblings.erase(remove(siblings.begin(), siblings.end(), node), siblings.end());
-    deleteNodeRec(node);
+    if (!node->parent || !unlinkNode(node)) return false;
 
     cout << "🗑️  File deleted: " << fullPath << endl;
     return true;
@@ -184,12 +682,7 @@ bool deleteDirectoryRecursive(const string& dirPath) {
         return false;
     }
 
-    FileNode* parent = node->parent;
-    if (!parent) return false;
-
-    auto& siblings = parent->children;
-    siblings.erase(remove(siblings.begin(), siblings.end(), node), siblings.end());
-    deleteNodeRec(node);
+    if (!node->parent || !unlinkNode(node)) return false;
 
     cout << "🗑️  Directory deleted (and all sub-contents removed): " << dirPath << endl;
     return true;
@@ -197,8 +690,9 @@ bool deleteDirectoryRecursive(const string& dirPath) {
 
 
 
-    void printTree(FileNode* node, int depth = 0) const {
+    void printTree(FileNode* node, int depth = 0) {
         if (!node) return;
+        if (lazy && !ensureLoaded(node)) return;
 
         for (int i = 0; i < depth; ++i) cout << "  ";
 
@@ -207,7 +701,7 @@ bool deleteDirectoryRecursive(const string& dirPath) {
         else
             cout << "📁 " << node->name << endl;
 
-        vector<FileNode*> sorted = node->children;
+        vector<FileNode*> sorted(node->children.begin(), node->children.end());
         sort(sorted.begin(), sorted.end(),
              [](FileNode* a, FileNode* b) { return a->name < b->name; });
 
@@ -245,9 +739,134 @@ bool deleteDirectoryRecursive(const string& dirPath) {
 
     FileNode* getRoot() { return root; }
 
+    string pathOf(const FileNode* node) const {
+        size_t len = 0;
+        for (const FileNode* n = node; n && n != root; n = n->parent)
+            len += n->name.size() + 1;
+        if (len == 0) return "/";
+        string path(len, '/');
+        for (const FileNode* n = node; n && n != root; n = n->parent) {
+            len -= n->name.size();
+            path.replace(len, n->name.size(), n->name.data(), n->name.size());
+            --len;
+        }
+        return path;
+    }
+
     void reset() {
-        deleteNodeRec(root);
-        root = new FileNode("root", false, nullptr);
+        lazy = false;
+        useClock = 0;
+        pageIns = evictions = 0;
+        destroyAll(root);
+        nodes.clear();
+        names.clear();
+        root = makeNode("root", false, nullptr);
+        tally = TreeCounts{};
+        dentries.clear();
+        keyChanges.clear();
+        resetSlots();
+    }
+
+    const TreeCounts& counts() const { return tally; }
+
+    // Records how many runs a file's data occupies (see writeFileContent).
+    void setExtentCount(FileNode* node, uint32_t extents) {
+        if (!node || !node->isFile) return;
+        countNode(node, -1);
+        node->extents = extents;
+        countNode(node, +1);
+    }
+
+    // Resident files only, in lazy mode.
+    template <typename Fn>
+    void forEachFile(Fn fn) {
+        vector<FileNode*> pending{root};
+        while (!pending.empty()) {
+            FileNode* n = pending.back();
+            pending.pop_back();
+            if (n->isFile) fn(n);
+            for (auto* c : n->children) pending.push_back(c);
+        }
+    }
+
+    // Number of FileEntry slots in the metadata region (default 512).
+    void setSlotCapacity(size_t n) {
+        slotCapacity = n;
+        reset();
+    }
+
+    size_t dirtyCount() const { return dirtySlots.size(); }
+    size_t slotCount() const { return slotCapacity; }
+
+    // Slots at or above this have never been used since the last load or
+    // reset, so a load can stop reading there.
+    uint32_t slotHighWater() const { return highWater; }
+
+    // Rewrites every slot on the next persist (format conversion).
+    void markAllDirty() {
+        for (size_t slot = 0; slot < slotCapacity; ++slot)
+            markDirty(static_cast<int32_t>(slot));
+    }
+
+    // Call after changing a node's persisted fields (size, blocks, ...).
+    void touch(FileNode* node) {
+        if (node) markDirty(slotOf(node->inode));
+    }
+
+    // O(1) inode -> node; nullptr for a free or out-of-range inode.
+    FileNode* nodeByInode(uint32_t inode) const {
+        if (inode == 0 || inode > inodeTable.size()) return nullptr;
+        return inodeTable[slotOf(inode)];
+    }
+
+    FileHandle handleOf(const FileNode* node) const {
+        if (!node || node->inode == 0) return {};
+        return {node->inode, generations[slotOf(node->inode)]};
+    }
+
+    // The node behind a handle, or nullptr if it was deleted since. In
+    // lazy mode an evicted node is paged back in.
+    FileNode* resolve(const FileHandle& h) {
+        FileNode* node = nodeByInode(h.inode);
+        if (!node && lazy && h.inode && h.inode <= slotCapacity) node = loadInode(h.inode);
+        return node && generations[slotOf(h.inode)] == h.generation ? node : nullptr;
+    }
+
+    // Turns path index bookkeeping on or off; either way starts afresh.
+    void trackIndexKeys(bool on) {
+        indexKeys = on;
+        keyChanges.clear();
+    }
+
+    // Hands out the index keys added or removed since the last call, in
+    // the order they happened.
+    void collectIndexChanges(vector<pair<bool, IndexKey>>& out) {
+        out.clear();
+        out.swap(keyChanges);
+    }
+
+    // Every persisted node's index key, sorted (for a bulk build).
+    void collectIndexKeys(vector<IndexKey>& out) const {
+        out.clear();
+        for (const FileNode* node : inodeTable)
+            if (node) out.push_back(indexKey(node->parent ? node->parent->inode : 0, node->name, node->inode));
+        sort(out.begin(), out.end());
+    }
+
+    // Hands out (slot, entry) for every slot changed since the last call, in
+    // slot order, and clears the dirty set. Freed slots come back zeroed.
+    void collectDirtyEntries(vector<pair<uint32_t, FileEntry>>& out) {
+        out.clear();
+        sort(dirtySlots.begin(), dirtySlots.end());
+        for (int32_t slot : dirtySlots) {
+            FileEntry entry{};
+            memset(&entry, 0, sizeof(FileEntry));
+            if (FileNode* node = inodeTable[slot])
+                entry = makeEntry(node);
+            out.emplace_back(static_cast<uint32_t>(slot), entry);
+            slotDirty[slot] = 0;
+        }
+        dirtySlots.clear();
     }
 
 
@@ -280,64 +899,421 @@ bool deleteDirectoryRecursive(const string& dirPath) {
         printTree(root);
     }
 
+// A search of every node below `start` (not `start` itself), for find().
+FindCursor findFrom(FileNode* start) {
+    FindCursor cursor;
+    if (start && !start->isFile) cursor.tasks.push_back({handleOf(start), 0, SIZE_MAX});
+    return cursor;
+}
+
+// Runs one round of the search in `cursor`: appends the nodes passing
+// `query` to `out`, in no particular order, and leaves the unsearched rest
+// in the cursor. A round pauses after K_FIND_ROUND matches or
+// K_FIND_ROUND_MS, so the caller can drop its lock between rounds.
+// Each worker keeps a queue of tasks (a directory, or a K_FIND_SLICE slice
+// of a larger one) and steals from the others when its own runs dry. A
+// lazy tree is searched on the calling thread, paging directories in as
+// it reaches them. Returns the number of matches added.
+size_t find(FindCursor& cursor, const FindQuery& query, vector<FindMatch>& out) {
+    out.clear();
+    if (cursor.done()) return 0;
+
+    struct Task {
+        FileNode* dir;
+        size_t begin, end;
+        string prefix;                  // dir's path with a trailing '/'
+    };
+
+    unsigned threads = 1;
+    if (!lazy) {
+        threads = searchThreads ? searchThreads : thread::hardware_concurrency();
+        const size_t total = size_t(tally.files) + tally.directories;
+        threads = static_cast<unsigned>(
+            max<size_t>(1, min<size_t>(max(1u, threads), total / K_SEARCH_NODES_PER_THREAD)));
+    }
+    vector<StealQueue<Task>> queues(threads);
+    atomic<size_t> pending{0};
+    atomic<bool> stop{false};
+    mutex emitLock;
+    const bool byPath = query.byPath();
+    const size_t left = query.limit ? query.limit - cursor.emitted : SIZE_MAX;
+    const auto deadline = chrono::steady_clock::now() + chrono::milliseconds(K_FIND_ROUND_MS);
+
+    auto enqueue = [&](unsigned t, FileNode* dir, const string& prefix, size_t begin, size_t end) {
+        if (lazy && !ensureLoaded(dir)) return;
+        end = min(end, dir->children.size());
+        for (size_t b = begin; b < end; b += K_FIND_SLICE) {
+            ++pending;
+            queues[t].push(Task{dir, b, min(end, b + K_FIND_SLICE), prefix});
+        }
+    };
+    // Caller holds emitLock.
+    auto flush = [&](vector<FindMatch>& batch) {
+        if (batch.size() > left - out.size()) batch.resize(left - out.size());
+        for (auto& m : batch) out.push_back(move(m));
+        if (out.size() >= min(left, K_FIND_ROUND)) stop = true;
+        batch.clear();
+    };
+
+    auto work = [&](unsigned t) {
+        vector<FindMatch> batch;
+        string path;
+        Task task;
+        while (!stop) {
+            bool got = queues[t].pop(task);
+            for (unsigned i = 1; !got && i < threads; ++i)
+                got = queues[(t + i) % threads].steal(task);
+            if (!got) {
+                if (pending == 0) break;
+                this_thread::yield();
+                continue;
+            }
+
+            size_t i = task.begin;
+            for (; i < task.end && !stop; ++i) {
+                FileNode* node = task.dir->children[i];
+                const uint64_t size = node->isFile ? node->size : 0;
+                const bool hit = (query.type < 0 || query.type == (node->isFile ? 0 : 1)) &&
+                                 size >= query.minSize && size <= query.maxSize &&
+                                 (byPath || globSegment(query.pattern, node->name));
+                if (!hit && node->isFile) continue;    // no path needed
+
+                path.assign(task.prefix).append(node->name.data(), node->name.size());
+                if (!node->isFile) enqueue(t, node, path + "/", 0, SIZE_MAX);
+                if (!hit || (byPath && !globPath(query.pattern, path))) continue;
+
+                batch.push_back(FindMatch{path, node->inode, node->isFile, size});
+                if (batch.size() >= K_FIND_BATCH) {
+                    lock_guard<mutex> g(emitLock);
+                    flush(batch);
+                }
+            }
+            if (i < task.end) {                 // paused: keep the rest
+                task.begin = i;
+                queues[t].push(move(task));
+                break;
+            }
+            if (!batch.empty() && emitLock.try_lock()) {
+                flush(batch);
+                emitLock.unlock();
+            }
+            --pending;
+            if (chrono::steady_clock::now() >= deadline) stop = true;
+        }
+        lock_guard<mutex> g(emitLock);
+        flush(batch);
+    };
 
+    // Resume the cursor's tasks, spread over the workers. Paths are taken
+    // afresh in case a directory was renamed since the last round.
+    unsigned next = 0;
+    for (const auto& c : cursor.tasks) {
+        FileNode* dir = c.dir.inode ? resolve(c.dir) : root;
+        if (!dir || dir->isFile) continue;
+        const string top = pathOf(dir);
+        enqueue(next, dir, top == "/" ? top : top + "/", c.begin, c.end);
+        next = (next + 1) % threads;
+    }
+    cursor.tasks.clear();
+
+    vector<thread> workers;
+    for (unsigned t = 1; t < threads; ++t)
+        workers.emplace_back(work, t);
+    work(0);
+    for (auto& w : workers) w.join();
+
+    cursor.emitted += out.size();
+    if (query.limit && cursor.emitted >= query.limit) return out.size();
+    Task task;
+    for (auto& q : queues)
+        while (q.steal(task)) cursor.tasks.push_back({handleOf(task.dir), task.begin, task.end});
+    return out.size();
+}
+
+// Threads for find() (0 = one per core).
+void setSearchThreads(unsigned n) { searchThreads = n; }
+
+
+// Image of the whole metadata table: entry i describes inode i + 1.
 void exportToEntries(vector<FileEntry>& entries) {
-    if (!root) return;
-    for (auto* child : root->children) {
-        exportNode(child, "/", entries); 
+    entries.assign(slotCapacity, FileEntry{});
+    for (size_t slot = 0; slot < slotCapacity; ++slot) {
+        memset(&entries[slot], 0, sizeof(FileEntry));
+        if (FileNode* node = inodeTable[slot])
+            entries[slot] = makeEntry(node);
     }
 }
 
-void exportNode(FileNode* node, const string& path, vector<FileEntry>& entries) {
-    if (!node) return;
+// Switches to lazy loading: only root is resident and pages its children
+// in on first use. `counts` are the totals saved in the header, and new
+// inodes come from above `hw`, since free slots below it are only known
+// after a full load.
+void startLazy(uint32_t hw, const TreeCounts& counts) {
+    reset();
+    lazy = true;
+    root->loaded = false;
+    tally = counts;
+    highWater = min<uint32_t>(hw, static_cast<uint32_t>(slotCapacity));
+    freeInodes.clear();
+    for (size_t i = slotCapacity; i > highWater; --i)
+        freeInodes.push_back(static_cast<uint32_t>(i));
+}
 
-    string full = (path == "/") ? ("/" + node->name) : (path + "/" + node->name);
+// Pages in every directory and leaves lazy mode. Every slot is then
+// accounted for, so the ones no node holds go back on the free list.
+bool loadAll() {
+    if (!lazy) return true;
+    if (!loadSubtree(root)) return false;
+    lazy = false;
+    freeInodes.clear();
+    for (size_t i = slotCapacity; i > 0; --i)
+        if (!inodeTable[i - 1]) freeInodes.push_back(static_cast<uint32_t>(i));
+    return true;
+}
 
-    FileEntry entry{};
-    memset(&entry, 0, sizeof(FileEntry));
-    strncpy(entry.name, full.c_str(), sizeof(entry.name) - 1);
-    entry.type = node->isFile ? 0 : 1;
-    entry.size = node->isFile ? node->data.size() : 0;
-    entry.permissions = 0644;
-    strncpy(entry.owner, "admin", sizeof(entry.owner) - 1);
-    entry.inode = reinterpret_cast<uint64_t>(node) & 0xFFFFFFFF;
-    entries.push_back(entry);
+// Lazy mode: once more than `budget` nodes are resident, unloads the least
+// recently used directories, deepest first, until a quarter of the budget
+// is free. Runs only between operations with nothing left to persist, so
+// no caller holds a node it drops. Root and /home stay resident.
+void evictCold(size_t budget) {
+    if (!lazy || nodes.liveCount() <= budget || !dirtySlots.empty() || !keyChanges.empty()) return;
+    const size_t target = budget - budget / 4;
+    FileNode* home = findChild(root, "home", true);
+    bool evicted = false;
+    while (nodes.liveCount() > target) {
+        // Loaded directories without a loaded subdirectory.
+        vector<FileNode*> leaves;
+        vector<FileNode*> pending{root};
+        while (!pending.empty()) {
+            FileNode* d = pending.back();
+            pending.pop_back();
+            bool inner = false;
+            for (FileNode* c : d->children) {
+                if (c->isFile || !c->loaded) continue;
+                pending.push_back(c);
+                inner = true;
+            }
+            if (!inner && d != root && d != home) leaves.push_back(d);
+        }
+        sort(leaves.begin(), leaves.end(),
+             [](const FileNode* a, const FileNode* b) { return a->lastUse < b->lastUse; });
 
-    if (!node->isFile) {
-        for (auto* child : node->children)
-            exportNode(child, full, entries);
+        bool progress = false;
+        for (FileNode* d : leaves) {
+            if (nodes.liveCount() <= target) break;
+            progress |= unloadDir(d);
+        }
+        evicted |= progress;
+        if (!progress) break;
     }
+    if (evicted) dentries.clear();
 }
 
-void importFromEntries(const vector<FileEntry>& entries) {
+bool lazyMode() const { return lazy; }
+size_t residentNodes() const { return nodes.liveCount(); }
+uint64_t pageInCount() const { return pageIns; }
+uint64_t evictionCount() const { return evictions; }
+
+// Threads for the parallel phases of importFromEntries (0 = one per core).
+void setImportThreads(unsigned n) { importThreads = n; }
+
+const ImportTimings& lastImportTimings() const { return timings; }
+
+// Rebuilds the tree from the metadata table. Entry i describes inode
+// i + 1 (see OMNI_FEATURE_PARENT_INDEX). Linear passes: parse every entry,
+// create every node, then link each one under its parent's inode. Parsing
+// and linking run across threads; creation shares one slab pool and name
+// table, so it stays serial. Nodes that do not reach root (missing parent,
+// parent is a file, a cycle) are dropped and their entries cleared.
+void importFromEntries(const vector<FileEntry>& entries, bool parentIndexed = true) {
+    if (!parentIndexed) {
+        importFromPathEntries(entries);
+        return;
+    }
+    auto mark = chrono::steady_clock::now();
+    auto lap = [&mark] {
+        auto now = chrono::steady_clock::now();
+        double ms = chrono::duration<double, milli>(now - mark).count();
+        mark = now;
+        return ms;
+    };
     reset();
 
-    auto ensurePath = [&](const string& fullPath, bool isDir) {
-        vector<string> parts = splitDirectory(fullPath);
-        FileNode* cur = root;
+    const size_t count = min(entries.size(), slotCapacity);
+    const unsigned threads = importThreadsFor(count);
+    timings = ImportTimings{};
+    timings.threads = threads;
+
+    // Chunk t files slot i in links[t][parent % threads]; reading the lists
+    // in chunk order keeps each directory's children in slot order.
+    struct Parsed {
+        uint32_t len;
+        size_t hash;
+    };
+    vector<Parsed> parsed(count);
+    vector<vector<vector<uint32_t>>> links(threads, vector<vector<uint32_t>>(threads));
+    runParallel(threads, count, [&](unsigned t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto& e = entries[i];
+            if (e.name[0] == '\0') {
+                parsed[i] = {0, 0};
+                continue;
+            }
+            const uint32_t len = static_cast<uint32_t>(strnlen(e.name, sizeof(e.name)));
+            parsed[i] = {len, hash<string_view>()(string_view(e.name, len))};
+            links[t][e.parent_inode % threads].push_back(static_cast<uint32_t>(i));
+        }
+    });
+    timings.parse = lap();
+
+    for (size_t i = 0; i < count; ++i) {
+        if (parsed[i].len == 0) continue;
+        const auto& e = entries[i];
+        FileNode* node = nodes.make(names.intern(string_view(e.name, parsed[i].len), parsed[i].hash),
+                                    e.type != 1, nullptr);
+        if (node->isFile) {
+            node->size = e.size;
+            node->blocks = {e.start_block, e.block_count};
+            // Extent-mapped files are counted once the caller reads their map.
+            node->extents = e.block_count == 0 || e.block_count == EXTENT_MAP_MARKER ? 0 : 1;
+        }
+        bindInode(node, static_cast<uint32_t>(i + 1));
+    }
+    timings.create = lap();
+
+    // Thread t links the children of every parent with inode % threads ==
+    // t, so no two threads touch the same children list or index. Each
+    // list is sized first, and big directories get their index up front
+    // instead of rebuilding it as they grow.
+    vector<uint32_t> fanout(count + 1, 0);
+    runParallel(threads, threads, [&](unsigned t, size_t, size_t) {
+        for (unsigned c = 0; c < threads; ++c)
+            for (uint32_t i : links[c][t]) {
+                const uint32_t p = entries[i].parent_inode;
+                if (p <= count) ++fanout[p];
+            }
+        for (unsigned c = 0; c < threads; ++c) {
+            for (uint32_t i : links[c][t]) {
+                const uint32_t p = entries[i].parent_inode;
+                FileNode* parent = p == 0 ? root : nodeByInode(p);
+                if (parent && fanout[p] && !parent->isFile) {
+                    parent->children.reserve(fanout[p]);
+                    if (fanout[p] > K_CHILD_INDEX_THRESHOLD)
+                        parent->childIndex.reset(new ChildTable<FileNode>(fanout[p]));
+                    fanout[p] = 0;
+                }
+            }
+        }
+        for (unsigned c = 0; c < threads; ++c) {
+            for (uint32_t i : links[c][t]) {
+                FileNode* node = inodeTable[i];
+                const uint32_t p = entries[i].parent_inode;
+                FileNode* parent = p == 0 ? root : nodeByInode(p);
+                if (parent && !parent->isFile && parent != node) linkChild(parent, node);
+            }
+        }
+    });
+    timings.link = lap();
+
+    vector<char> reached(slotCapacity, 0);
+    vector<FileNode*> pending{root};
+    while (!pending.empty()) {
+        FileNode* n = pending.back();
+        pending.pop_back();
+        if (n != root) {
+            reached[slotOf(n->inode)] = 1;
+            countNode(n, +1);
+        }
+        for (auto* c : n->children) pending.push_back(c);
+    }
 
-        for (size_t i = 0; i < parts.size(); ++i) {
-            bool last = (i == parts.size() - 1);
-            const string& name = parts[i];
+    size_t dropped = 0;
+    freeInodes.clear();
+    for (size_t i = slotCapacity; i > 0; --i) {
+        const size_t slot = i - 1;
+        if (FileNode* node = inodeTable[slot]) {
+            if (reached[slot]) {
+                if (entries[slot].inode != i) markDirty(static_cast<int32_t>(slot));
+                continue;
+            }
+            if (indexKeys)
+                keyChanges.emplace_back(false, indexKey(entries[slot].parent_inode, node->name, node->inode));
+            names.release(node->name);
+            nodes.destroy(node);
+            inodeTable[slot] = nullptr;
+            markDirty(static_cast<int32_t>(slot));
+            ++dropped;
+        }
+        freeInodes.push_back(static_cast<uint32_t>(i));
+    }
+    if (dropped)
+        cerr << "⚠️ Dropped " << dropped << " metadata entries not reachable from root.\n";
+    timings.verify = lap();
+}
 
-            FileNode* child = nullptr;
-            for (auto* c : cur->children)
-                if (c->name == name) { child = c; break; }
+// Legacy format: every entry holds a full path, re-walked from root.
+void importFromPathEntries(const vector<FileEntry>& entries) {
+    reset();
 
-            if (!child) {
-                child = new FileNode(name, last && !isDir, cur);
-                cur->children.push_back(child);
+    // Walks the components of fullPath in place, creating missing ones.
+    auto ensurePath = [&](string_view path, bool isDir) {
+        FileNode* cur = root;
+        size_t pos = 0;
+        while (pos < path.size()) {
+            size_t next = path.find('/', pos);
+            if (next == string_view::npos) next = path.size();
+            if (next > pos) {
+                string_view name = path.substr(pos, next - pos);
+                bool last = path.find_first_not_of('/', next) == string_view::npos;
+                FileNode* child = findChild(cur, name, false);
+                if (!child)
+                    child = addChild(cur, name, last && !isDir);
+                cur = child;
             }
-            cur = child;
+            pos = next + 1;
         }
+        return cur;
     };
 
-    for (const auto& e : entries) {
+    // Entry i holds inode i + 1. Nodes created only as intermediate path
+    // components, and duplicate entries, are fixed up afterwards; entries
+    // written before inodes were stable get their number rewritten.
+    vector<char> used(slotCapacity, 0);
+    vector<int32_t> stale;
+    for (size_t i = 0; i < entries.size() && i < slotCapacity; ++i) {
+        const auto& e = entries[i];
         if (e.name[0] == '\0') continue;
-        string path = e.name;
+        string_view path(e.name, strnlen(e.name, sizeof(e.name)));
         bool isDir = (e.type == 1);
-        ensurePath(path, isDir);
+        FileNode* node = ensurePath(path, isDir);
+        if (node->isFile) {
+            node->size = e.size;
+            node->blocks = {e.start_block, e.block_count};
+            // Extent-mapped files are counted once the caller reads their map.
+            setExtentCount(node, e.block_count == 0 || e.block_count == EXTENT_MAP_MARKER ? 0 : 1);
+        }
+        if (node->inode == 0 && node != root) {
+            bindInode(node, static_cast<uint32_t>(i + 1));
+            used[i] = 1;
+            if (e.inode != i + 1) stale.push_back(static_cast<int32_t>(i));
+        } else {
+            stale.push_back(static_cast<int32_t>(i));
+        }
+    }
+
+    freeInodes.clear();
+    for (size_t i = slotCapacity; i > 0; --i)
+        if (!used[i - 1]) freeInodes.push_back(static_cast<uint32_t>(i));
+    for (int32_t slot : stale) markDirty(slot);
+
+    vector<FileNode*> pending{root};
+    while (!pending.empty()) {
+        FileNode* n = pending.back();
+        pending.pop_back();
+        if (n != root && n->inode == 0) allocInode(n);
+        for (auto* c : n->children) pending.push_back(c);
     }
+    keyChanges.clear();   // legacy containers have no index yet
 }
 
 
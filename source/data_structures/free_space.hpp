@@ -1,54 +1,381 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <map>
+#include <set>
 #include <algorithm>
+#include <cstdint>
+
+#include "../include/core/odf_types.hpp"
 using namespace std;
 
+// Block allocation bitmap: one bit per block (1 = used), packed into
+// uint64_t words in the same layout as the on-disk free map. Words changed
+// since the last collectDirtyWords() are tracked so only those are rewritten.
+//
+// Above the bitmap sits a summary hierarchy: bit k of summary[0][j] is set
+// when bitmap word j*64+k still has a free block, and each higher level
+// summarizes the one below the same way, up to a single word. Finding the
+// next free block is a count-trailing-zeros per level, i.e. O(log64 n), and
+// the free count is maintained rather than recounted.
+//
+// Free space is also indexed as maximal free extents, by address and by
+// (length, address), so contiguous runs are found by best-fit in O(log E)
+// and the largest free extent is always known.
 class FreeSpace {
 private:
-    vector<bool> freeMap;
+    vector<uint64_t> words;
+    vector<vector<uint64_t>> summary;
     int totalBlocks;
+    int freeCount = 0;
+    int cursor = 0;                 // next-fit start for allocateBlock()
+    vector<char> wordDirty;
+    vector<uint32_t> dirtyWords;
+
+    map<uint32_t, uint32_t> freeByAddr;         // start -> length
+    set<pair<uint32_t, uint32_t>> freeBySize;   // (length, start)
+
+    static size_t wordCount(size_t bits) { return (bits + 63) / 64; }
+
+    bool test(int i) const { return (words[i >> 6] >> (i & 63)) & 1ULL; }
+
+    // Bits past the last block are kept set so they are never allocated.
+    uint64_t tailMask() const {
+        const int rem = totalBlocks % 64;
+        return rem ? ~((1ULL << rem) - 1) : 0;
+    }
+
+    void touchWord(size_t w) {
+        if (wordDirty[w]) return;
+        wordDirty[w] = 1;
+        dirtyWords.push_back(static_cast<uint32_t>(w));
+    }
+
+    // Propagates "word w has a free block" up the summary levels, stopping
+    // as soon as a level's word does not change state.
+    void updateSummary(size_t w) {
+        bool hasFree = words[w] != ~0ULL;
+        for (auto& level : summary) {
+            uint64_t& s = level[w >> 6];
+            const bool wasNonZero = s != 0;
+            const uint64_t bit = 1ULL << (w & 63);
+            s = hasFree ? (s | bit) : (s & ~bit);
+            if ((s != 0) == wasNonZero) return;
+            hasFree = s != 0;
+            w >>= 6;
+        }
+    }
+
+    void rebuildSummary() {
+        summary.clear();
+        size_t n = words.size();
+        const vector<uint64_t>* below = &words;
+        bool bitmapLevel = true;
+        do {
+            vector<uint64_t> level(wordCount(n), 0);
+            for (size_t i = 0; i < n; ++i) {
+                const bool set = bitmapLevel ? (*below)[i] != ~0ULL : (*below)[i] != 0;
+                if (set) level[i >> 6] |= 1ULL << (i & 63);
+            }
+            summary.push_back(move(level));
+            below = &summary.back();
+            bitmapLevel = false;
+            n = summary.back().size();
+        } while (n > 1);
+    }
+
+    // First set bit at index >= pos in summary[lvl], or -1.
+    long long nextSet(size_t lvl, size_t pos) const {
+        const auto& s = summary[lvl];
+        size_t wi = pos >> 6;
+        if (wi >= s.size()) return -1;
+        const uint64_t m = s[wi] & (~0ULL << (pos & 63));
+        if (m) return static_cast<long long>(wi * 64 + __builtin_ctzll(m));
+        if (lvl + 1 == summary.size()) return -1;
+        const long long up = nextSet(lvl + 1, wi + 1);
+        if (up < 0) return -1;
+        return up * 64 + __builtin_ctzll(s[up]);
+    }
+
+    // First free block at index >= from, or -1.
+    int findFree(int from) const {
+        if (from < 0) from = 0;
+        if (from >= totalBlocks) return -1;
+        size_t w = static_cast<size_t>(from) >> 6;
+        const uint64_t m = ~words[w] & (~0ULL << (from & 63));
+        if (m) return static_cast<int>(w * 64 + __builtin_ctzll(m));
+        const long long next = nextSet(0, w + 1);
+        if (next < 0) return -1;
+        return static_cast<int>(next * 64 + __builtin_ctzll(~words[next]));
+    }
+
+    // First used block at index >= from, or totalBlocks.
+    int findUsed(int from) const {
+        if (from >= totalBlocks) return totalBlocks;
+        size_t w = static_cast<size_t>(from) >> 6;
+        uint64_t m = words[w] & (~0ULL << (from & 63));
+        while (!m && ++w < words.size()) m = words[w];
+        if (!m) return totalBlocks;
+        return min(totalBlocks, static_cast<int>(w * 64 + __builtin_ctzll(m)));
+    }
+
+    void setBit(int i, bool used) {
+        const uint64_t bit = 1ULL << (i & 63);
+        const size_t wi = static_cast<size_t>(i >> 6);
+        uint64_t& w = words[wi];
+        const uint64_t next = used ? (w | bit) : (w & ~bit);
+        if (next == w) return;
+
+        const bool wasFull = w == ~0ULL;
+        w = next;
+        freeCount += used ? -1 : 1;
+        touchWord(wi);
+        if (wasFull != (w == ~0ULL)) updateSummary(wi);
+    }
+
+    void indexInsert(uint32_t start, uint32_t len) {
+        freeByAddr[start] = len;
+        freeBySize.insert({len, start});
+    }
+
+    void indexErase(map<uint32_t, uint32_t>::iterator it) {
+        freeBySize.erase({it->second, it->first});
+        freeByAddr.erase(it);
+    }
+
+    // Marks [a, b) used: trims every free extent overlapping the range.
+    void indexTake(uint32_t a, uint32_t b) {
+        auto it = freeByAddr.upper_bound(a);
+        if (it != freeByAddr.begin()) --it;
+        while (it != freeByAddr.end() && it->first < b) {
+            const uint32_t s = it->first, e = it->first + it->second;
+            if (e <= a) { ++it; continue; }
+            auto next = std::next(it);
+            indexErase(it);
+            if (s < a) indexInsert(s, a - s);
+            if (e > b) indexInsert(b, e - b);
+            it = next;
+        }
+    }
+
+    // Marks [a, b) free: merges it with any overlapping or adjacent extents.
+    void indexGive(uint32_t a, uint32_t b) {
+        auto it = freeByAddr.upper_bound(a);
+        if (it != freeByAddr.begin()) --it;
+        while (it != freeByAddr.end() && it->first <= b) {
+            const uint32_t s = it->first, e = it->first + it->second;
+            if (e < a) { ++it; continue; }
+            a = min(a, s);
+            b = max(b, e);
+            auto next = std::next(it);
+            indexErase(it);
+            it = next;
+        }
+        indexInsert(a, b - a);
+    }
+
+    void rebuildIndex() {
+        freeByAddr.clear();
+        freeBySize.clear();
+        for (int p = findFree(0); p >= 0;) {
+            const int e = findUsed(p);
+            indexInsert(static_cast<uint32_t>(p), static_cast<uint32_t>(e - p));
+            p = findFree(e);
+        }
+    }
+
+    void markRange(uint32_t start, uint32_t count, bool used) {
+        const uint32_t end = min<uint64_t>(static_cast<uint64_t>(start) + count, static_cast<uint32_t>(totalBlocks));
+        if (start >= end) return;
+        for (uint32_t i = start; i < end; ++i)
+            setBit(static_cast<int>(i), used);
+        if (used) indexTake(start, end);
+        else indexGive(start, end);
+    }
+
+    void markExtent(const Extent& e, bool used) { markRange(e.start, e.count, used); }
+
+    void resize(int blocks) {
+        totalBlocks = blocks;
+        words.assign(wordCount(blocks), 0);
+        if (!words.empty()) words.back() |= tailMask();
+        wordDirty.assign(words.size(), 0);
+        dirtyWords.clear();
+        freeCount = blocks;
+        cursor = 0;
+        rebuildSummary();
+        rebuildIndex();
+    }
 
 public:
-    FreeSpace(int total = 256) : totalBlocks(total) {
-        freeMap.assign(totalBlocks, false); 
+    FreeSpace(int total = 256) {
+        resize(total);
     }
 
+    // Clears every bit; the whole map counts as dirty.
     void reset() {
-        fill(freeMap.begin(), freeMap.end(), false); 
+        resize(totalBlocks);
+        for (size_t w = 0; w < words.size(); ++w) touchWord(w);
     }
 
+    // Next-fit: continues after the last allocation and wraps once.
     int allocateBlock() {
-        for (int i = 0; i < totalBlocks; ++i) {
-            if (!freeMap[i]) {
-                freeMap[i] = true;
-                return i;
-            }
-        }
-        return -1; 
+        int i = findFree(cursor);
+        if (i < 0) i = findFree(0);
+        if (i < 0) return -1;
+        markRange(static_cast<uint32_t>(i), 1, true);
+        cursor = i + 1;
+        return i;
+    }
+
+    // The highest free block: metadata pages fill the region from the end
+    // so they stay out of the runs file data is carved from.
+    int allocateHighBlock() {
+        if (freeByAddr.empty()) return -1;
+        auto last = std::prev(freeByAddr.end());
+        const uint32_t block = last->first + last->second - 1;
+        markRange(block, 1, true);
+        return static_cast<int>(block);
     }
 
     void freeBlock(int index) {
         if (index >= 0 && index < totalBlocks)
-            freeMap[index] = false;
+            markRange(static_cast<uint32_t>(index), 1, false);
     }
 
-    int getFreeCount() const {
-        return count(freeMap.begin(), freeMap.end(), false);
+    // Best fit: the smallest free extent that holds n blocks, from its start.
+    bool allocateRun(uint32_t n, Extent& out) {
+        if (n == 0) return false;
+        auto it = freeBySize.lower_bound({n, 0});
+        if (it == freeBySize.end()) return false;
+        out = {it->second, n};
+        markExtent(out, true);
+        return true;
     }
 
+    // A run of n blocks at or after `hint` (e.g. next to a file's existing
+    // data), wrapping around; falls back to best fit.
+    bool allocateNear(uint32_t hint, uint32_t n, Extent& out) {
+        if (n == 0) return false;
+        auto it = freeByAddr.upper_bound(hint);
+        if (it != freeByAddr.begin()) {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second >= static_cast<uint64_t>(hint) + n) {
+                out = {hint, n};
+                markExtent(out, true);
+                return true;
+            }
+        }
+        for (auto scan = it; scan != freeByAddr.end(); ++scan)
+            if (scan->second >= n) {
+                out = {scan->first, n};
+                markExtent(out, true);
+                return true;
+            }
+        return allocateRun(n, out);
+    }
+
+    void freeRun(uint32_t start, uint32_t n) { markRange(start, n, false); }
+
+    // Allocates n blocks in as few contiguous runs as possible: a best-fit
+    // run if one is large enough, otherwise the largest extents first with
+    // a best-fit run for the remainder. Fails (allocating nothing) if that
+    // would need more than maxRuns runs.
+    bool allocateExtents(uint32_t n, vector<Extent>& out, size_t maxRuns) {
+        out.clear();
+        if (n == 0) return true;
+        if (n > static_cast<uint32_t>(freeCount) || maxRuns == 0) return false;
+
+        // Extents at or after `next` (descending size order) are untaken.
+        uint32_t remaining = n;
+        auto next = freeBySize.rbegin();
+        while (remaining > 0) {
+            if (next == freeBySize.rend()) break;
+            auto fit = freeBySize.lower_bound({remaining, 0});
+            if (fit != freeBySize.end() && *fit <= *next) {
+                out.push_back({fit->second, remaining});
+                remaining = 0;
+                break;
+            }
+            if (out.size() + 1 == maxRuns) break;
+            out.push_back({next->second, next->first});
+            remaining -= next->first;
+            ++next;
+        }
+
+        if (remaining > 0) {
+            out.clear();
+            return false;
+        }
+        for (const auto& e : out) markExtent(e, true);
+        return true;
+    }
+
+    void freeExtents(const vector<Extent>& extents) {
+        for (const auto& e : extents) markExtent(e, false);
+    }
+
+    // Blocks from `first` onward do not map into the data region (they
+    // overlap version storage / change log), so keep them out of allocation.
+    void reserveFrom(int first) {
+        if (first < totalBlocks)
+            markRange(static_cast<uint32_t>(max(first, 0)), static_cast<uint32_t>(totalBlocks - max(first, 0)), true);
+    }
+
+    uint32_t largestFreeExtent() const {
+        return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+    }
+
+    size_t freeExtentCount() const { return freeByAddr.size(); }
+
+    bool isUsed(int i) const { return i >= 0 && i < totalBlocks && test(i); }
+
+    int getFreeCount() const { return freeCount; }
+
     vector<bool> getMap() const {
-        return freeMap;
+        vector<bool> map(totalBlocks);
+        for (int i = 0; i < totalBlocks; ++i) map[i] = test(i);
+        return map;
     }
 
+    // Legacy one-byte-per-block map (containers without the packed flag).
     void setMap(const vector<bool>& map) {
-        freeMap = map;
+        resize(static_cast<int>(map.size()));
+        for (int i = 0; i < totalBlocks; ++i)
+            if (map[i]) words[i >> 6] |= 1ULL << (i & 63);
+        freeCount = totalBlocks - count(map.begin(), map.end(), true);
+        rebuildSummary();
+        rebuildIndex();
     }
 
+    const vector<uint64_t>& getWords() const { return words; }
+
+    void setWords(const vector<uint64_t>& packed, int blocks) {
+        resize(blocks);
+        copy_n(packed.begin(), min(packed.size(), words.size()), words.begin());
+        if (!words.empty()) words.back() |= tailMask();
+        int used = 0;
+        for (uint64_t w : words) used += __builtin_popcountll(w);
+        freeCount = static_cast<int>(words.size() * 64) - used;
+        rebuildSummary();
+        rebuildIndex();
+    }
+
+    // Indices of words changed since the last call, ascending; clears them.
+    vector<uint32_t> collectDirtyWords() {
+        vector<uint32_t> out;
+        out.swap(dirtyWords);
+        sort(out.begin(), out.end());
+        for (uint32_t w : out) wordDirty[w] = 0;
+        return out;
+    }
+
+    int size() const { return totalBlocks; }
+
     void print() const {
         cout << "\nFree Space Map:\n";
         for (int i = 0; i < totalBlocks; ++i) {
-            cout << (freeMap[i] ? '1' : '0');
+            cout << (test(i) ? '1' : '0');
             if ((i + 1) % 10 == 0) cout << ' ';
         }
         cout << "\n(0 = free, 1 = used)\n";
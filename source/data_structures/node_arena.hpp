@@ -0,0 +1,344 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+// Fixed-size object pool carved out of large slabs.
+//
+// Objects live side by side in slabs of SlabSize, so building a tree is a
+// pointer bump per node instead of a malloc, and nodes created together
+// share cache lines. Freed objects go on a free list and are reused first.
+// clear() hands every slot back at once; the caller must already have run
+// the destructors of live objects.
+template <typename T, size_t SlabSize = 1024>
+class SlabPool {
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    vector<unique_ptr<Slot[]>> slabs;
+    Slot* freeList = nullptr;
+    size_t used = 0;        // slots handed out of the newest slab
+    size_t live = 0;
+
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    template <typename... Args>
+    T* make(Args&&... args) {
+        Slot* s;
+        if (freeList) {
+            s = freeList;
+            freeList = freeList->next;
+        } else {
+            if (slabs.empty() || used == SlabSize) {
+                slabs.emplace_back(new Slot[SlabSize]);
+                used = 0;
+            }
+            s = &slabs.back()[used++];
+        }
+        ++live;
+        return new (s->storage) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* obj) {
+        if (!obj) return;
+        obj->~T();
+        Slot* s = reinterpret_cast<Slot*>(obj);
+        s->next = freeList;
+        freeList = s;
+        --live;
+    }
+
+    // Forgets every object; keeps the first slab for the next build.
+    void clear() {
+        if (slabs.size() > 1) slabs.resize(1);
+        freeList = nullptr;
+        used = 0;
+        live = 0;
+    }
+
+    size_t liveCount() const { return live; }
+    size_t reservedBytes() const { return slabs.size() * SlabSize * sizeof(Slot); }
+};
+
+// Reference-counted string interning. Every FileNode name is a view into
+// this table, so a name shared by many nodes ("docs", "readme.txt", ...)
+// is stored once.
+//
+// Each distinct name is one record, [refs][len][chars], bump-allocated from
+// 64 KB chunks; records never move, so views stay valid until the last
+// reference is released. Released records are reused for names of the
+// same length. Lookup is an open-addressing table of record pointers.
+class NameTable {
+    static constexpr size_t CHUNK = 64 * 1024;
+    static constexpr size_t HEADER = 2 * sizeof(uint32_t);
+
+    vector<unique_ptr<char[]>> chunks;
+    size_t chunkUsed = CHUNK;
+    vector<char*> table;                // nullptr = empty
+    vector<vector<char*>> freeByLen;    // released records, by length
+    size_t live = 0;
+    size_t tombstones = 0;
+    size_t bytes = 0;
+
+    static char* const TOMBSTONE;
+
+    static uint32_t& refs(char* rec) { return *reinterpret_cast<uint32_t*>(rec); }
+    static uint32_t length(const char* rec) { return *reinterpret_cast<const uint32_t*>(rec + sizeof(uint32_t)); }
+    static string_view view(const char* rec) { return string_view(rec + HEADER, length(rec)); }
+
+    char* allocate(size_t len) {
+        if (len < freeByLen.size() && !freeByLen[len].empty()) {
+            char* rec = freeByLen[len].back();
+            freeByLen[len].pop_back();
+            return rec;
+        }
+        size_t need = (HEADER + len + 1 + 7) & ~size_t(7);
+        if (need > CHUNK) {
+            // Oversized names get a chunk of their own, kept in front so
+            // the bump chunk stays last.
+            chunks.emplace(chunks.begin(), new char[need]);
+            bytes += need;
+            return chunks.front().get();
+        }
+        if (chunkUsed + need > CHUNK) {
+            chunks.emplace_back(new char[CHUNK]);
+            chunkUsed = 0;
+            bytes += CHUNK;
+        }
+        char* rec = chunks.back().get() + chunkUsed;
+        chunkUsed += need;
+        return rec;
+    }
+
+    void rehash(size_t size) {
+        vector<char*> old;
+        old.swap(table);
+        table.assign(size, nullptr);
+        tombstones = 0;
+        for (char* rec : old) {
+            if (!rec || rec == TOMBSTONE) continue;
+            size_t i = hash<string_view>()(view(rec)) & (table.size() - 1);
+            while (table[i]) i = (i + 1) & (table.size() - 1);
+            table[i] = rec;
+        }
+    }
+
+    // Slot holding name, or the empty slot where it would go.
+    size_t probe(string_view name, size_t h) const {
+        size_t mask = table.size() - 1;
+        size_t i = h & mask;
+        size_t firstFree = SIZE_MAX;
+        while (table[i]) {
+            if (table[i] == TOMBSTONE) {
+                if (firstFree == SIZE_MAX) firstFree = i;
+            } else if (view(table[i]) == name) {
+                return i;
+            }
+            i = (i + 1) & mask;
+        }
+        return firstFree != SIZE_MAX ? firstFree : i;
+    }
+
+public:
+    NameTable() { table.assign(64, nullptr); }
+
+    string_view intern(string_view name) { return intern(name, hash<string_view>()(name)); }
+
+    // h must be hash<string_view>()(name); lets a bulk load hash names in
+    // parallel and intern them serially.
+    string_view intern(string_view name, size_t h) {
+        if ((live + tombstones + 1) * 2 > table.size())
+            rehash(live * 4 > table.size() ? table.size() * 2 : table.size());
+
+        size_t i = probe(name, h);
+        if (table[i] && table[i] != TOMBSTONE) {
+            ++refs(table[i]);
+            return view(table[i]);
+        }
+
+        char* rec = allocate(name.size());
+        refs(rec) = 1;
+        *reinterpret_cast<uint32_t*>(rec + sizeof(uint32_t)) = static_cast<uint32_t>(name.size());
+        memcpy(rec + HEADER, name.data(), name.size());
+        rec[HEADER + name.size()] = '\0';
+
+        if (table[i] == TOMBSTONE) --tombstones;
+        table[i] = rec;
+        ++live;
+        return view(rec);
+    }
+
+    void release(string_view name) {
+        if (name.data() == nullptr) return;
+        char* rec = const_cast<char*>(name.data()) - HEADER;
+        if (--refs(rec) > 0) return;
+
+        size_t i = probe(name, hash<string_view>()(name));
+        if (table[i] == rec) {
+            table[i] = TOMBSTONE;
+            ++tombstones;
+        }
+        --live;
+        size_t len = name.size();
+        if (((HEADER + len + 1 + 7) & ~size_t(7)) <= CHUNK) {
+            if (freeByLen.size() <= len) freeByLen.resize(len + 1);
+            freeByLen[len].push_back(rec);
+        }
+    }
+
+    void clear() {
+        chunks.clear();
+        chunkUsed = CHUNK;
+        table.assign(64, nullptr);
+        freeByLen.clear();
+        live = tombstones = bytes = 0;
+    }
+
+    size_t size() const { return live; }
+    size_t reservedBytes() const { return bytes + table.size() * sizeof(char*); }
+};
+
+inline char* const NameTable::TOMBSTONE = reinterpret_cast<char*>(uintptr_t(1));
+
+// Open-addressing name index over one directory's children (8 bytes per
+// slot, at most half full). Node must expose `name` and `childSeq`.
+// Duplicate names (a file and a directory) are allowed; find() returns the
+// earliest-inserted match.
+template <typename Node>
+class ChildTable {
+    vector<Node*> slots;
+    size_t live = 0;
+    size_t tombstones = 0;
+
+    static Node* tombstone() { return reinterpret_cast<Node*>(uintptr_t(1)); }
+
+    void rehash(size_t size) {
+        vector<Node*> old;
+        old.swap(slots);
+        slots.assign(size, nullptr);
+        tombstones = 0;
+        for (Node* n : old)
+            if (n && n != tombstone()) place(n);
+    }
+
+    void place(Node* n) {
+        size_t mask = slots.size() - 1;
+        size_t i = hash<string_view>()(n->name) & mask;
+        while (slots[i] && slots[i] != tombstone()) i = (i + 1) & mask;
+        if (slots[i] == tombstone()) --tombstones;
+        slots[i] = n;
+    }
+
+public:
+    explicit ChildTable(size_t expected) {
+        size_t size = 16;
+        while (size < expected * 2) size <<= 1;
+        slots.assign(size, nullptr);
+    }
+
+    void insert(Node* n) {
+        if ((live + tombstones + 1) * 2 > slots.size())
+            rehash(live * 4 > slots.size() ? slots.size() * 2 : slots.size());
+        place(n);
+        ++live;
+    }
+
+    template <typename Pred>
+    Node* find(string_view name, Pred accept) const {
+        size_t mask = slots.size() - 1;
+        Node* best = nullptr;
+        for (size_t i = hash<string_view>()(name) & mask; slots[i]; i = (i + 1) & mask) {
+            Node* n = slots[i];
+            if (n == tombstone() || n->name != name || !accept(n)) continue;
+            if (!best || n->childSeq < best->childSeq) best = n;
+        }
+        return best;
+    }
+
+    void erase(Node* n) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash<string_view>()(n->name) & mask; slots[i]; i = (i + 1) & mask) {
+            if (slots[i] == n) {
+                slots[i] = tombstone();
+                ++tombstones;
+                --live;
+                return;
+            }
+        }
+    }
+};
+
+// Pointer array for a directory's children: one pointer and two 32-bit
+// counts (16 bytes) instead of a vector's three pointers, and no heap
+// block at all for files and empty directories.
+template <typename T>
+class PtrList {
+    T** items = nullptr;
+    uint32_t count = 0;
+    uint32_t cap = 0;
+
+    void grow() {
+        uint32_t n = cap ? cap * 2 : 4;
+        T** p = static_cast<T**>(realloc(items, n * sizeof(T*)));
+        if (!p) throw bad_alloc();
+        items = p;
+        cap = n;
+    }
+
+public:
+    PtrList() = default;
+    PtrList(const PtrList&) = delete;
+    PtrList& operator=(const PtrList&) = delete;
+    ~PtrList() { free(items); }
+
+    T** begin() const { return items; }
+    T** end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T*& operator[](size_t i) const { return items[i]; }
+    T* back() const { return items[count - 1]; }
+
+    void reserve(size_t n) {
+        if (n <= cap) return;
+        T** p = static_cast<T**>(realloc(items, n * sizeof(T*)));
+        if (!p) throw bad_alloc();
+        items = p;
+        cap = static_cast<uint32_t>(n);
+    }
+
+    void push_back(T* p) {
+        if (count == cap) grow();
+        items[count++] = p;
+    }
+    void pop_back() { --count; }
+
+    // Order-preserving removal of p.
+    void erase(T* p) {
+        T** e = end();
+        T** it = std::find(begin(), e, p);
+        if (it == e) return;
+        std::move(it + 1, e, it);
+        --count;
+    }
+
+    void clear() {
+        free(items);
+        items = nullptr;
+        count = cap = 0;
+    }
+};
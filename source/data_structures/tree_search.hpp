@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+
+using namespace std;
+
+// Building blocks for DirectoryTree::find(): glob matching, the query and
+// match records, and the per-worker task queue.
+
+// One character against the pattern item at p[i] ('?', a [...] class, an
+// escaped or a literal character). Sets `next` past the item.
+inline bool globItem(string_view p, size_t i, char c, size_t& next) {
+    if (p[i] == '?') {
+        next = i + 1;
+        return true;
+    }
+    if (p[i] == '[') {
+        size_t j = i + 1;
+        bool negate = j < p.size() && (p[j] == '!' || p[j] == '^');
+        if (negate) ++j;
+        bool hit = false;
+        for (bool first = true; j < p.size() && (first || p[j] != ']'); first = false) {
+            char lo = p[j], hi = lo;
+            if (j + 2 < p.size() && p[j + 1] == '-' && p[j + 2] != ']') {
+                hi = p[j + 2];
+                j += 3;
+            } else {
+                ++j;
+            }
+            hit |= lo <= c && c <= hi;
+        }
+        if (j < p.size()) {             // closed class
+            next = j + 1;
+            return hit != negate;
+        }
+        // No closing ']': the '[' is literal.
+    }
+    if (p[i] == '\\' && i + 1 < p.size()) {
+        next = i + 2;
+        return p[i + 1] == c;
+    }
+    next = i + 1;
+    return p[i] == c;
+}
+
+// Glob over one path component: '*', '?', [a-z], [!a-z] and '\' escapes.
+// Backtracks to the last '*' only, so it runs in O(|p| * |s|).
+inline bool globSegment(string_view p, string_view s) {
+    size_t pi = 0, si = 0, star = string_view::npos, starS = 0;
+    while (si < s.size()) {
+        size_t next;
+        if (pi < p.size() && p[pi] == '*') {
+            star = ++pi;
+            starS = si;
+        } else if (pi < p.size() && globItem(p, pi, s[si], next)) {
+            pi = next;
+            ++si;
+        } else if (star != string_view::npos) {
+            pi = star;
+            si = ++starS;
+        } else {
+            return false;
+        }
+    }
+    while (pi < p.size() && p[pi] == '*') ++pi;
+    return pi == p.size();
+}
+
+// Glob over a whole path, one component at a time, so '*' never crosses a
+// '/'. A "**" component matches any number of components.
+inline bool globPath(string_view p, string_view s) {
+    const size_t ps = p.find('/');
+    const string_view head = p.substr(0, ps);
+    if (head == "**") {
+        if (ps == string_view::npos) return true;
+        const string_view rest = p.substr(ps + 1);
+        for (size_t i = 0;;) {
+            if (globPath(rest, s.substr(i))) return true;
+            size_t slash = s.find('/', i);
+            if (slash == string_view::npos) return false;
+            i = slash + 1;
+        }
+    }
+    const size_t ss = s.find('/');
+    if (!globSegment(head, s.substr(0, ss))) return false;
+    if (ps == string_view::npos || ss == string_view::npos)
+        return ps == string_view::npos && ss == string_view::npos;
+    return globPath(p.substr(ps + 1), s.substr(ss + 1));
+}
+
+// FIND filters. A pattern without '/' matches node names; with one, it
+// matches absolute paths ("/home/*/docs/**/*.txt").
+struct FindQuery {
+    string pattern = "*";
+    int type = -1;                      // -1 = any, 0 = files, 1 = directories
+    uint64_t minSize = 0;
+    uint64_t maxSize = UINT64_MAX;
+    size_t limit = 0;                   // stop after this many matches, 0 = no limit
+
+    bool byPath() const { return pattern.find('/') != string::npos; }
+};
+
+struct FindMatch {
+    string path;
+    uint32_t inode;
+    bool isFile;
+    uint64_t size;
+};
+
+// A worker's tasks: the owner pushes and pops at the back, idle workers
+// steal from the front, so a thief takes the oldest (usually largest) task.
+template <typename T>
+class StealQueue {
+    mutex lock;
+    deque<T> items;
+
+public:
+    void push(T item) {
+        lock_guard<mutex> g(lock);
+        items.push_back(move(item));
+    }
+
+    bool pop(T& out) {
+        lock_guard<mutex> g(lock);
+        if (items.empty()) return false;
+        out = move(items.back());
+        items.pop_back();
+        return true;
+    }
+
+    bool steal(T& out) {
+        lock_guard<mutex> g(lock);
+        if (items.empty()) return false;
+        out = move(items.front());
+        items.pop_front();
+        return true;
+    }
+};
@@ -4,6 +4,11 @@
 #include <vector>
 #include <ctime>
 #include <cstring>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
 
 #include "../../data_structures/session_manger.hpp"
 #include "../../data_structures/user_manager.hpp"
@@ -11,10 +16,35 @@
 #include "../../data_structures/free_space.hpp"
 #include "odf_types.hpp"
 #include "file_io_manager.hpp"
+#include "stats_engine.hpp"
+#include "defragmenter.hpp"
+#include "metadata_table.hpp"
+#include "path_index.hpp"
 
 using namespace std;
 
-static constexpr uint32_t K_MAX_META_ENTRIES = 512; 
+static constexpr uint32_t K_MAX_META_ENTRIES = 512;             // slots in the fixed metadata region
+static constexpr uint32_t K_META_SEGMENT_MIN_BLOCKS = 4;       // smallest metadata growth step
+static constexpr uint32_t K_META_SEGMENT_MAX_BLOCKS = 1024;    // largest (4 MiB with 4 KiB blocks)
+static constexpr uint32_t K_CHANGE_LOG_ENTRIES = 64;           // room kept before the journal
+static constexpr uint64_t K_MAX_JOURNAL_BYTES = 4ull << 20;     // journal region cap (4 MiB)
+
+// Wall time of each loadSystem() phase, in milliseconds.
+struct StartupTimings {
+    double header = 0;      // open + header read
+    double journal = 0;     // journal attach and replay
+    double freeMap = 0;
+    double users = 0;
+    double metaRead = 0;    // metadata table, read in K_META_READ_CHUNK pieces
+    double import = 0;      // tree rebuild (see ImportTimings)
+    double upgrade = 0;     // format upgrades and path index build, if any
+    double extents = 0;     // extent map run counts
+    double total = 0;
+    size_t entries = 0;
+    unsigned readers = 1;
+    bool lazy = false;      // namespace paged in on demand; no table read or import
+    ImportTimings tree;
+};
 
 class OFSCore {
 private:
@@ -22,6 +52,15 @@ private:
     DirectoryTree dirTree;
     FreeSpace spaceManager;
     FileIOManager fileManager;
+    MetadataTable metaTable;
+    PathIndex pathIndex;
+    StatsEngine statsEngine{spaceManager, dirTree};
+    Defragmenter defrag;
+
+    // Foreground operations hold stateLock for their whole run, except for
+    // waiting on their journal commits (see Foreground). The defragmenter
+    // takes it once per chunk, so it only ever runs between client requests.
+    recursive_mutex stateLock;
 
     OMNIHeader header{};
     FSStats stats{};
@@ -29,20 +68,127 @@ private:
     uint64_t dataStartOffset = 0;
     bool isInitialized = false;
     string omniFileName = "filesystem.omni";
+    unsigned loadThreads = 0;       // 0 = one per core
+    StartupTimings startup;
+    bool lazyNamespace = false;     // see setLazyLoad
+    size_t residentBudget = 0;      // nodes kept in memory in lazy mode, 0 = no limit
+    int foregroundDepth = 0;
 
     vector<UserInfo> userTable;
     uint64_t userTableOffset = sizeof(OMNIHeader);
     SessionManager* session = nullptr;
 
-    void updateStats() {
-        vector<bool> map = spaceManager.getMap();
-        uint64_t used = count(map.begin(), map.end(), true);
-        uint64_t free = count(map.begin(), map.end(), false);
+    // The container is opened once (format/loadSystem) and kept open; this
+    // only reopens it if nothing has opened it yet.
+    bool ensureOpen() {
+        return fileManager.openFile(omniFileName, 4096);
+    }
+
+    // Region offsets. The free map region is totalBlocks bytes long whether
+    // it holds the packed bitmap or the legacy byte-per-block map.
+    uint64_t freeMapStart() const { return userTableOffset + 10 * sizeof(UserInfo); }
+    uint64_t metaStart() const { return freeMapStart() + totalBlocks; }
+
+    // Writes the free-map words changed since the last call.
+    void persistFreeMap() {
+        vector<uint32_t> dirty = spaceManager.collectDirtyWords();
+        if (!dirty.empty())
+            fileManager.writeFreeMapWords(spaceManager.getWords(), dirty, freeMapStart());
+    }
+
+    // Holds stateLock for one foreground operation. When the outermost one
+    // ends, a lazy tree sheds cold directories; no caller is left holding
+    // a node by then. Its journal commits are only appended under the lock;
+    // the fdatasync and home writes run after it is released, so requests
+    // from several clients share one group commit. The caller still returns
+    // only once its own commits are durable.
+    class Foreground {
+        OFSCore* core;
+        unique_lock<recursive_mutex> lock;
+
+    public:
+        explicit Foreground(OFSCore* c) : core(c), lock(c->stateLock) {
+            if (core->foregroundDepth++ == 0) core->fileManager.deferCommits(true);
+        }
+        Foreground(const Foreground&) = delete;
+        ~Foreground() {
+            if (--core->foregroundDepth > 0) return;
+            if (core->residentBudget) core->dirTree.evictCold(core->residentBudget);
+            core->fileManager.deferCommits(false);
+            lock.unlock();
+            core->fileManager.finishCommits();
+        }
+    };
+
+    Foreground foreground() {
+        defrag.noteForeground();
+        return Foreground(this);
+    }
+
+    // Lazy page-in: a directory's children from the path index, their
+    // entries read in runs of adjacent slots. Keys whose entry no longer
+    // names this parent are skipped.
+    bool pageInDirectory(uint32_t dirInode, vector<PagedEntry>& out) {
+        out.clear();
+        vector<uint32_t> inodes;
+        if (!pathIndex.children(dirInode, inodes)) return false;
+        sort(inodes.begin(), inodes.end());
+        inodes.erase(unique(inodes.begin(), inodes.end()), inodes.end());
+
+        const size_t capacity = metaTable.capacity();
+        vector<FileEntry> run;
+        for (size_t i = 0; i < inodes.size();) {
+            if (inodes[i] == 0 || inodes[i] > capacity) {
+                ++i;
+                continue;
+            }
+            const uint64_t offset = metaTable.offsetOf(inodes[i] - 1);
+            size_t j = i + 1;
+            while (j < inodes.size() && inodes[j] == inodes[j - 1] + 1 && inodes[j] <= capacity &&
+                   metaTable.offsetOf(inodes[j] - 1) == offset + (j - i) * sizeof(FileEntry))
+                ++j;
+            run.resize(j - i);
+            if (!fileManager.readFileEntries(run.data(), offset, run.size())) return false;
+            for (size_t k = 0; k < run.size(); ++k) {
+                const FileEntry& e = run[k];
+                if (e.inode != inodes[i + k] || e.parent_inode != dirInode || e.name[0] == '\0') continue;
+                uint32_t extents = 0;
+                if (e.type != 1 && e.block_count == EXTENT_MAP_MARKER) {
+                    vector<Extent> runs;
+                    if (resolveExtents({e.start_block, e.block_count}, runs))
+                        extents = static_cast<uint32_t>(runs.size());
+                } else if (e.type != 1 && e.block_count) {
+                    extents = 1;
+                }
+                out.push_back({e, extents});
+            }
+            i = j;
+        }
+        return true;
+    }
+
+    // Copies the tree totals into the header; true if anything changed.
+    bool publishTreeCounts() {
+        const TreeCounts& c = dirTree.counts();
+        if ((header.feature_flags & OMNI_FEATURE_TREE_COUNTS) && header.tree_files == c.files &&
+            header.tree_directories == c.directories && header.tree_fragmented == c.fragmentedFiles &&
+            header.tree_extents == c.extents)
+            return false;
+        header.feature_flags |= OMNI_FEATURE_TREE_COUNTS;
+        header.tree_files = c.files;
+        header.tree_directories = c.directories;
+        header.tree_fragmented = c.fragmentedFiles;
+        header.tree_extents = c.extents;
+        return true;
+    }
+
+    // O(1): reads the counters FreeSpace and DirectoryTree maintain.
+    void refreshStats() {
+        statsEngine.snapshot(stats, header.total_size, header.block_size, totalBlocks);
+    }
 
-        stats.total_size = header.total_size;
-        stats.used_space = used * header.block_size;
-        stats.free_space = free * header.block_size;
-        stats.fragmentation = ((double)used / (double)totalBlocks) * 100.0;
+    void updateStats() {
+        refreshStats();
 
         cout << "\n--- File System Stats Updated ---\n";
         cout << "Total Size: " << stats.total_size / 1024 << " KB\n";
@@ -60,6 +206,12 @@ public:
         uint64_t totalSize = blocks * blockSize;
         header = OMNIHeader(0x00010000, totalSize, sizeof(OMNIHeader), blockSize);
         stats = FSStats(totalSize, 0, totalSize);
+        dirTree.setSlotCapacity(K_MAX_META_ENTRIES);
+        dirTree.growSlots = [this] { return growMetadata(); };
+        dirTree.pageIn = [this](uint32_t inode, vector<PagedEntry>& out) { return pageInDirectory(inode, out); };
+        dirTree.readEntry = [this](uint32_t inode, FileEntry& e) {
+            return inode <= metaTable.capacity() && fileManager.readFileEntry(e, metaTable.offsetOf(inode - 1));
+        };
 
         userManager->addUser("admin", "admin123", true);
         cout << "Default admin (admin / admin123) created.\n";
@@ -72,41 +224,281 @@ public:
     
     
     void saveSystem() {
+        auto guard = foreground();
         if (!isInitialized) return;
 
         cout << "\n💾 Saving OFS system state...\n";
-        if (!fileManager.openFile(omniFileName, 4096)) {
+        if (!ensureOpen()) {
             cerr << "❌ Could not open .omni for saving.\n";
             return;
         }
 
 
-        vector<FileEntry> entries;
-        dirTree.exportToEntries(entries);
-        const uint64_t metaOffset = sizeof(OMNIHeader) + (10 * sizeof(UserInfo)) + totalBlocks;
-        fileManager.writeFileEntries(entries, metaOffset);
+        fileManager.beginTransaction();
+        persistEntries();
 
         
-        const uint64_t freeMapOffset = sizeof(OMNIHeader) + (10 * sizeof(UserInfo));
-        fileManager.writeFreeMap(spaceManager.getMap(), freeMapOffset);
+        persistFreeMap();
 
         
         fileManager.saveUsers(userTable, userTableOffset);
+        fileManager.commitTransaction();
 
-        fileManager.closeFile();
         cout << "✅ OFS state saved successfully.\n";
     }
 
 
     ~OFSCore() {
+        defrag.stop();
         saveSystem();
         cout << "OFSCore shutting down." << endl;
     }
 
     void attachSession(SessionManager* s) { session = s; }
 
+    // Selects pread/pwrite or mmap-backed container access. Takes effect
+    // immediately if the container is already open.
+    void setIOMode(IOMode mode) { fileManager.setMode(mode); }
+
+    // Sizes the block cache in front of readFileData (0 disables it).
+    void setBlockCacheSize(size_t blocks) { fileManager.blockCache().configure(blocks); }
+
+    // Sizes the path -> node cache in front of findNodeByPath (0 disables it).
+    void setDentryCacheSize(size_t entries) { dirTree.dentryCache().configure(entries); }
+
+    // Threads loadSystem uses to read and rebuild the metadata (0 = one per core).
+    void setLoadThreads(unsigned n) {
+        loadThreads = n;
+        dirTree.setImportThreads(n);
+    }
+
+    // Runs fn and returns what it printed to cout, for server replies.
+    // cout is process-wide, so the swap holds stateLock. Background work
+    // (defrag) and other requests print only under that lock, so their
+    // output cannot end up in the capture.
+    template <typename Fn>
+    string captureOutput(Fn fn) {
+        auto guard = foreground();
+        ostringstream out;
+        struct Redirect {
+            streambuf* old;
+            ~Redirect() { cout.rdbuf(old); }    // also if fn throws
+        } redirect{cout.rdbuf(out.rdbuf())};
+        fn();
+        return out.str();
+    }
+
+    // Runs fn under stateLock, for callers that print outside OFSCore
+    // (session login/logout), so they never race a captureOutput swap.
+    template <typename Fn>
+    auto withStateLock(Fn fn) {
+        auto guard = foreground();
+        return fn();
+    }
+
+    // Threads for FIND traversals (0 = one per core).
+    void setSearchThreads(unsigned n) { dirTree.setSearchThreads(n); }
+
+    // Lazy mode: loadSystem reads only the header, free map and users, and
+    // directories page in from the path index on first use. Past
+    // residentNodes nodes in memory (0 = no limit), cold directories are
+    // dropped again. Containers without the path index or saved tree
+    // totals load in full.
+    void setLazyLoad(bool on, size_t residentNodes) {
+        lazyNamespace = on;
+        residentBudget = on ? residentNodes : 0;
+    }
+
+    // Routes batched writes and multi-extent reads through io_uring.
+    bool enableAsyncIO() { return fileManager.enableAsyncIO(); }
+
+    // Writes the FileEntry slots changed since the last call and applies
+    // the matching path index updates. The header is rewritten when new
+    // slots came into use, the index changed shape or the tree totals moved.
+    void persistEntries() {
+        if (dirTree.dirtyCount() == 0) return;
+        vector<pair<uint32_t, FileEntry>> dirty;
+        dirTree.collectDirtyEntries(dirty);
+        fileManager.writeFileEntrySlots(dirty, [this](uint32_t slot) { return metaTable.offsetOf(slot); });
+
+        bool headerChanged = false;
+        if (dirTree.slotHighWater() > header.meta_high_water) {
+            header.meta_high_water = dirTree.slotHighWater();
+            headerChanged = true;
+        }
+        if (header.feature_flags & OMNI_FEATURE_PATH_INDEX) {
+            vector<pair<bool, IndexKey>> changes;
+            dirTree.collectIndexChanges(changes);
+            for (const auto& c : changes) {
+                if (c.first ? pathIndex.insert(c.second) : pathIndex.erase(c.second)) continue;
+                dropPathIndex();
+                headerChanged = true;
+                break;
+            }
+            headerChanged |= publishPathIndex();
+            persistFreeMap();   // pages taken by splits
+        }
+        headerChanged |= publishTreeCounts();
+        if (headerChanged) fileManager.writeHeader(header);
+    }
+
+    // Copies the index root into the header; true if anything changed.
+    bool publishPathIndex() {
+        if (header.index_root_block == pathIndex.root() && header.index_levels == pathIndex.height() &&
+            header.index_pages == pathIndex.pageCount())
+            return false;
+        header.index_root_block = pathIndex.root();
+        header.index_levels = pathIndex.height();
+        header.index_pages = pathIndex.pageCount();
+        return true;
+    }
+
+    // Gives up on the index after a failed update (no space, damaged
+    // page): its pages are freed and the next load rebuilds it. A lazy
+    // tree pages everything in first, while the index can still be read;
+    // the keys of directories not yet loaded are untouched by the failure.
+    void dropPathIndex() {
+        cerr << "⚠️ Path index dropped; it will be rebuilt on the next load.\n";
+        if (!dirTree.loadAll())
+            cerr << "⚠️ Some directories could not be paged in; they reappear after a full load.\n";
+        pathIndex.release();
+        header.feature_flags &= ~OMNI_FEATURE_PATH_INDEX;
+        dirTree.trackIndexKeys(false);
+        publishPathIndex();
+    }
+
+    // Bulk-builds the index from the loaded tree. The pages are written
+    // and flushed before the header points at them, so a crash midway
+    // leaves the container as it was.
+    void buildPathIndex() {
+        vector<IndexKey> keys;
+        dirTree.collectIndexKeys(keys);
+        if (!pathIndex.build(keys)) {
+            cerr << "⚠️ Not enough free space for the path index; lookups use the in-memory tree only.\n";
+            return;
+        }
+        fileManager.flushToDisk();
+        fileManager.beginTransaction();
+        header.feature_flags |= OMNI_FEATURE_PATH_INDEX;
+        publishPathIndex();
+        fileManager.writeHeader(header);
+        persistFreeMap();
+        fileManager.commitTransaction();
+        dirTree.trackIndexKeys(true);
+        cout << "🗂️ Path index built: " << keys.size() << " entries, " << pathIndex.height()
+             << " levels, " << pathIndex.pageCount() << " pages.\n";
+    }
+
+    // Chains one more metadata segment, sized to roughly double the table
+    // and halved until the data region has a run that big. Returns the
+    // slots added, 0 when the container is full.
+    size_t growMetadata() {
+        if (!isInitialized || !ensureOpen()) return 0;
+        const uint64_t blockSize = header.block_size;
+        uint64_t want = (metaTable.capacity() * sizeof(FileEntry) + blockSize - 1) / blockSize;
+        uint32_t blocks = static_cast<uint32_t>(
+            min<uint64_t>(max<uint64_t>(want, K_META_SEGMENT_MIN_BLOCKS), K_META_SEGMENT_MAX_BLOCKS));
+
+        Extent run{0, 0};
+        while (!spaceManager.allocateRun(blocks, run)) {
+            if (blocks == 1) {
+                cerr << "⚠️ No free space left to grow the metadata region.\n";
+                return 0;
+            }
+            blocks /= 2;
+        }
+        fileManager.blockCache().invalidateRange(run.start, run.count);
+
+        fileManager.beginTransaction();
+        MetadataTable::Segment seg = metaTable.append(fileManager, run.start, run.count);
+        if (header.meta_segments == 0) header.meta_root_block = run.start;
+        header.meta_segments = static_cast<uint32_t>(metaTable.chain().size());
+        fileManager.writeHeader(header);
+        persistFreeMap();
+        fileManager.commitTransaction();
+
+        cout << "🗂️ Metadata region grew by " << seg.slotCount << " slots (" << run.count
+             << " blocks at #" << run.start << ").\n";
+        return seg.slotCount;
+    }
+
+    void printStartupTimings() const {
+        const ImportTimings& t = startup.tree;
+        ostringstream out;
+        out << fixed << setprecision(2);
+        out << "⏱️ Startup: " << startup.total << " ms for " << startup.entries << " entries"
+            << (startup.lazy ? " (lazy)" : "")
+            << " | header " << startup.header << " | journal " << startup.journal
+            << " | free map " << startup.freeMap << " | users " << startup.users
+            << " | metadata read " << startup.metaRead << " (" << startup.readers << " reader(s))"
+            << " | import " << startup.import << " (parse " << t.parse << ", create " << t.create
+            << ", link " << t.link << ", verify " << t.verify << "; " << t.threads << " thread(s))"
+            << " | upgrade " << startup.upgrade << " | extents " << startup.extents << "\n";
+        cout << out.str();
+    }
+
+    void printStats() {
+        auto guard = foreground();
+        refreshStats();
+        BlockCache& cache = fileManager.blockCache();
+        const uint64_t hits = cache.hitCount();
+        const uint64_t misses = cache.missCount();
+
+        cout << "\n--- File System Stats ---\n";
+        cout << "Total Size: " << stats.total_size / 1024 << " KB\n";
+        cout << "Used Space: " << stats.used_space / 1024 << " KB\n";
+        cout << "Free Space: " << stats.free_space / 1024 << " KB\n";
+        cout << "Fragmentation: " << stats.fragmentation << "%\n";
+        statsEngine.print();
+        printDefragStatus();
+        cout << "\n--- Block Cache ---\n";
+        cout << "Cached Blocks: " << cache.size() << " / " << cache.capacity() << "\n";
+        cout << "Hits: " << hits << " | Misses: " << misses;
+        if (hits + misses > 0)
+            cout << " | Hit Rate: " << (100.0 * hits / (hits + misses)) << "%";
+        cout << "\n";
+        DentryCache& dentries = dirTree.dentryCache();
+        const uint64_t dHits = dentries.hitCount() + dentries.negativeHitCount();
+        const uint64_t dMisses = dentries.missCount();
+        cout << "\n--- Dentry Cache ---\n";
+        cout << "Cached Paths: " << dentries.size() << " / " << dentries.capacity() << "\n";
+        cout << "Hits: " << dentries.hitCount() << " | Negative Hits: " << dentries.negativeHitCount()
+             << " | Misses: " << dMisses;
+        if (dHits + dMisses > 0)
+            cout << " | Hit Rate: " << (100.0 * dHits / (dHits + dMisses)) << "%";
+        cout << "\n";
+        cout << "Invalidations: " << dentries.invalidationCount() << "\n";
+        cout << "\n--- Metadata ---\n";
+        cout << "Slots: " << dirTree.slotHighWater() << " used / " << metaTable.capacity()
+             << " | Segments: " << metaTable.chain().size() << "\n";
+        cout << "\n--- Namespace ---\n";
+        cout << "Mode: " << (dirTree.lazyMode() ? "lazy" : "resident") << " | Nodes in memory: "
+             << dirTree.residentNodes();
+        if (dirTree.lazyMode())
+            cout << " | Page-ins: " << dirTree.pageInCount() << " | Evictions: " << dirTree.evictionCount();
+        cout << "\n";
+        cout << "\n--- Startup ---\n";
+        printStartupTimings();
+        cout << "\n--- Path Index ---\n";
+        if (header.feature_flags & OMNI_FEATURE_PATH_INDEX)
+            cout << "Levels: " << pathIndex.height() << " | Pages: " << pathIndex.pageCount()
+                 << " | Page Reads: " << pathIndex.pageReadCount() << "\n";
+        else
+            cout << "Not built\n";
+        cout << "\n--- Journal ---\n";
+        if (!fileManager.journalActive()) {
+            cout << "Disabled (container has no journal region)\n";
+            return;
+        }
+        cout << "Commits: " << fileManager.journalCommits()
+             << " | Syncs: " << fileManager.journalSyncs()
+             << " | Checkpoints: " << fileManager.journalCheckpoints() << "\n";
+    }
+
    
    void format() {
+    defrag.stop();
+    auto guard = foreground();
     if (!session || !session->isActive() || !session->isAdminUser()) {
         cerr << "❌ Access Denied: Please log in as an Admin to format the system.\n";
         return;
@@ -115,13 +507,13 @@ public:
 
     cout << "🧹 Formatting OFS...\n";
     spaceManager.reset();
-    dirTree.reset();
+    dirTree.setSlotCapacity(K_MAX_META_ENTRIES);
 
     const uint64_t blockSize = 4096;
     const uint64_t totalSize = totalBlocks * blockSize;
 
+    // createOmniFile leaves the container open; it stays open from here on.
     fileManager.createOmniFile(omniFileName, totalSize, blockSize);
-    fileManager.openFile(omniFileName, blockSize);
 
     memset(&header, 0, sizeof(header));
     strncpy(header.magic, "OMNIFS01", sizeof(header.magic));
@@ -138,18 +530,22 @@ public:
     vector<UserInfo> emptyUsers(10);
     fileManager.writeUsers(emptyUsers, userTableOffset);
 
-    const uint64_t freeMapOffset = userTableOffset + (emptyUsers.size() * sizeof(UserInfo));
-    vector<bool> freeMap(totalBlocks, false);
-    fileManager.writeFreeMap(freeMap, freeMapOffset);
+    const uint64_t freeMapOffset = freeMapStart();
+    spaceManager.collectDirtyWords();
+    fileManager.writeFreeMapWords(spaceManager.getWords(), freeMapOffset);
 
-    const uint64_t metaOffset = freeMapOffset + freeMap.size();
+    const uint64_t metaOffset = metaStart();
     vector<FileEntry> reserved(K_MAX_META_ENTRIES);
     fileManager.writeFileEntries(reserved, metaOffset);
 
 
     dataStartOffset = metaOffset + (uint64_t)K_MAX_META_ENTRIES * sizeof(FileEntry);
+    metaTable.configure(metaOffset, K_MAX_META_ENTRIES, dataStartOffset, blockSize);
     const uint64_t remaining = (totalSize > dataStartOffset ? totalSize - dataStartOffset : 0);
-    const uint64_t dataRegionSize = static_cast<uint64_t>(remaining * 9 / 10);
+
+    // The journal takes the block-aligned tail of the container.
+    const uint64_t journalBytes = min<uint64_t>(K_MAX_JOURNAL_BYTES, remaining / 8) & ~(blockSize - 1);
+    const uint64_t dataRegionSize = static_cast<uint64_t>((remaining - journalBytes) * 9 / 10);
     uint64_t versionStart = dataStartOffset + dataRegionSize;
     if (versionStart > totalSize) versionStart = totalSize;
 
@@ -161,10 +557,19 @@ public:
     uint64_t changeLogOffset = versionStart + versionBytes;
     if (changeLogOffset > totalSize) changeLogOffset = totalSize;
 
+    const uint64_t journalOffset = totalSize - journalBytes;
+    const bool journalFits = journalBytes >= 2 * blockSize &&
+        changeLogOffset + K_CHANGE_LOG_ENTRIES * sizeof(ChangeLogEntry) <= journalOffset;
+
     header.user_table_offset = static_cast<uint32_t>(userTableOffset);
     header.max_users = 10;
     header.file_state_storage_offset = static_cast<uint32_t>(versionStart);
     header.change_log_offset = static_cast<uint32_t>(changeLogOffset);
+    header.journal_offset = journalFits ? static_cast<uint32_t>(journalOffset) : 0;
+    header.journal_size = journalFits ? static_cast<uint32_t>(journalBytes) : 0;
+    header.feature_flags = OMNI_FEATURE_PACKED_FREE_MAP | OMNI_FEATURE_PARENT_INDEX |
+                           OMNI_FEATURE_META_SEGMENTS | OMNI_FEATURE_PATH_INDEX |
+                           OMNI_FEATURE_TREE_COUNTS;
 
     cout << "🧭 DEBUG OFFSETS:\n";
     cout << "Header start          : 0\n";
@@ -174,10 +579,12 @@ public:
     cout << "Data start offset     : " << dataStartOffset << "\n";
     cout << "Version storage offset: " << header.file_state_storage_offset << "\n";
     cout << "Change log offset     : " << header.change_log_offset << "\n";
+    cout << "Journal offset        : " << header.journal_offset << "\n";
 
     
-    fileManager.seekToStart();
     fileManager.writeHeader(header);
+    if (header.journal_offset)
+        fileManager.formatJournal(header.journal_offset, header.journal_size);
 
     
     userTable.assign(10, UserInfo());
@@ -187,8 +594,8 @@ public:
     userTable[0].created_time = time(nullptr);
     userTable[0].is_active = 1;
     fileManager.saveUsers(userTable, userTableOffset);
+    fileManager.sync();
 
-    fileManager.closeFile();
     isInitialized = true;
     cout << "✅ OFS formatted successfully by Admin.\n";
     updateStats();
@@ -207,7 +614,9 @@ public:
 
   
 
-    bool writeFileContent(const string& filePath, const string& fileData) {
+    bool writeFileContent(const string& filePath, const string& fileData, Extent* rootOut = nullptr,
+                          uint32_t* extentsOut = nullptr) {
+        auto guard = foreground();
     if (!session || !session->isLoggedIn()) {
         cerr << "❌ Access Denied: You must be logged in to write files.\n";
         return false;
@@ -222,46 +631,127 @@ public:
     cout << "✏️ Writing file content as user: " << session->getCurrentUser() << endl;
     cout << "📁 Target path: " << actualPath << endl;
 
-    if (!fileManager.openFile(omniFileName, 4096)) {
+    if (!ensureOpen()) {
         cerr << "❌ Could not open .omni for write.\n";
         return false;
     }
 
-    const uint64_t blockSize = 4096;
-    int blockIndex = spaceManager.allocateBlock();
-    if (blockIndex == -1) {
-        cerr << "❌ No free space available.\n";
-        fileManager.closeFile();
+    const uint64_t blockSize = header.block_size;
+    const uint32_t blocksNeeded =
+        static_cast<uint32_t>(max<uint64_t>(1, (fileData.size() + blockSize - 1) / blockSize));
+    const size_t maxRuns = (blockSize - sizeof(ExtentMapHeader)) / sizeof(Extent);
+
+    vector<Extent> extents;
+    if (!spaceManager.allocateExtents(blocksNeeded, extents, maxRuns)) {
+        cerr << "❌ No free space available for " << blocksNeeded << " blocks.\n";
         return false;
     }
 
-    vector<char> buffer(fileData.begin(), fileData.end());
-    if (!fileManager.writeFileData(dataStartOffset, blockIndex, blockSize, buffer)) {
-        cerr << "❌ Failed to write file data.\n";
-        fileManager.closeFile();
-        return false;
+    // Data extents, extent map, free map and version block commit together.
+    fileManager.beginTransaction();
+
+    // A file that lands in one run is referenced directly; otherwise its run
+    // list goes into an extent map block.
+    Extent root = extents.front();
+    Extent mapBlock{0, 0};
+    if (extents.size() > 1) {
+        if (!spaceManager.allocateNear(extents.front().start, 1, mapBlock)) {
+            spaceManager.freeExtents(extents);
+            fileManager.abortTransaction();
+            cerr << "❌ No free block for the extent map.\n";
+            return false;
+        }
+        root = {mapBlock.start, EXTENT_MAP_MARKER};
+        fileManager.writeExtentMap(dataStartOffset, root.start, blockSize, extents);
+    }
+
+    size_t written = 0;
+    for (const auto& e : extents) {
+        size_t len = min<uint64_t>(fileData.size() - written, static_cast<uint64_t>(e.count) * blockSize);
+        if (!fileManager.writeExtent(dataStartOffset, e, blockSize, fileData.data() + written, len)) {
+            spaceManager.freeExtents(extents);
+            if (mapBlock.count) spaceManager.freeRun(mapBlock.start, mapBlock.count);
+            fileManager.abortTransaction();
+            cerr << "❌ Failed to write file data.\n";
+            return false;
+        }
+        written += len;
     }
 
-    cout << "💾 Wrote " << buffer.size() << " bytes to block #" << blockIndex
-         << " (offset " << (dataStartOffset + static_cast<uint64_t>(blockIndex) * blockSize) << ")\n";
+    cout << "💾 Wrote " << fileData.size() << " bytes in " << extents.size()
+         << " extent(s) starting at block #" << extents.front().start << "\n";
 
-    fileManager.writeFreeMap(spaceManager.getMap(),
-        sizeof(OMNIHeader) + (10 * sizeof(UserInfo)));
+    persistFreeMap();
 
     updateStats();
     session->recordOperation();
 
-    saveFileVersion(actualPath, blockIndex);
+    saveFileVersion(actualPath, root);
+    if (!fileManager.commitTransaction()) {
+        cerr << "❌ Failed to write file data.\n";
+        return false;
+    }
 
-    fileManager.closeFile();
+    if (rootOut) *rootOut = root;
+    if (extentsOut) *extentsOut = static_cast<uint32_t>(extents.size());
     cout << "✅ File stored successfully by user: " << session->getCurrentUser() << "\n";
     return true;
 }
 
+// Expands a data root (FileEntry/VersionBlock encoding) into its runs.
+bool resolveExtents(const Extent& root, vector<Extent>& extents) {
+    extents.clear();
+    if (root.count == 0) return true;
+    if (root.count != EXTENT_MAP_MARKER) {
+        extents.push_back(root);
+        return true;
+    }
+    return fileManager.readExtentMap(dataStartOffset, root.start, header.block_size, extents);
+}
+
+// Gives a data root that nothing refers to back to the free map: its runs
+// and, for a multi-run file, the extent-map block.
+void releaseData(const Extent& root) {
+    vector<Extent> runs;
+    if (resolveExtents(root, runs)) spaceManager.freeExtents(runs);
+    if (root.count == EXTENT_MAP_MARKER) spaceManager.freeRun(root.start, 1);
+}
+
+// Reads a file's data with one sequential read per extent. When the logical
+// size is unknown (version blocks), the content ends at the first NUL.
+bool readData(const Extent& root, uint64_t size, string& out) {
+    out.clear();
+    vector<Extent> extents;
+    if (!ensureOpen() || !resolveExtents(root, extents)) return false;
+
+    uint64_t capacity = 0;
+    for (const auto& e : extents) capacity += static_cast<uint64_t>(e.count) * header.block_size;
+    const bool knownSize = size != UINT64_MAX;
+    out.resize(knownSize ? min(size, capacity) : capacity);
+
+    if (!out.empty() &&
+        !fileManager.readExtents(dataStartOffset, extents, header.block_size, &out[0], out.size()))
+        return false;
+
+    if (!knownSize) out.resize(strnlen(out.data(), out.size()));
+    return true;
+}
+
 
 bool loadSystem() {
+    defrag.stop();
+    auto guard = foreground();
     cout << "\nLoading OFS from " << omniFileName << "...\n";
-    if (!fileManager.openFile(omniFileName, 4096)) {
+    startup = StartupTimings{};
+    const auto started = chrono::steady_clock::now();
+    auto mark = started;
+    auto lap = [&mark] {
+        auto now = chrono::steady_clock::now();
+        double ms = chrono::duration<double, milli>(now - mark).count();
+        mark = now;
+        return ms;
+    };
+    if (!ensureOpen()) {
         cerr << "❌ Error: Could not open .omni file.\n";
         return false;
     }
@@ -269,27 +759,52 @@ bool loadSystem() {
     OMNIHeader tmp{};
     if (!fileManager.readHeader(tmp)) {
         cerr << "❌ Error: Failed to read header.\n";
-        fileManager.closeFile();
         return false;
     }
 
     if (strcmp(tmp.magic, "OMNIFS01") != 0) {
         cerr << "❌ ERROR: Invalid header magic read ('" << tmp.magic << "').\n";
-        fileManager.closeFile();
         return false;
     }
 
     header = tmp;
     const uint64_t blockSize = header.block_size;
     totalBlocks = header.total_size / blockSize;
+    startup.header = lap();
 
-    
-    const uint64_t userTableOffset = sizeof(OMNIHeader);
-    const uint64_t freeMapOffset   = userTableOffset + (uint64_t)header.max_users * sizeof(UserInfo);
-    const uint64_t metaOffset      = freeMapOffset + (uint64_t)totalBlocks; 
+    // Redo anything committed to the journal before the last shutdown.
+    if (header.journal_offset)
+        fileManager.attachJournal(header.journal_offset, header.journal_size);
+    startup.journal = lap();
+
+    const uint64_t freeMapOffset   = freeMapStart();
+    const uint64_t metaOffset      = metaStart();
     dataStartOffset                = metaOffset + (uint64_t)K_MAX_META_ENTRIES * sizeof(FileEntry);
 
-    
+    // Restore the allocator so existing file blocks are not handed out again.
+    // Legacy byte maps are converted to the packed format on first load.
+    if (header.feature_flags & OMNI_FEATURE_PACKED_FREE_MAP) {
+        vector<uint64_t> words;
+        fileManager.readFreeMapWords(words, freeMapOffset, static_cast<uint32_t>(totalBlocks));
+        spaceManager.setWords(words, static_cast<int>(totalBlocks));
+    } else {
+        vector<bool> freeMap;
+        fileManager.readFreeMap(freeMap, freeMapOffset, static_cast<uint32_t>(totalBlocks));
+        spaceManager.setMap(freeMap);
+
+        header.feature_flags |= OMNI_FEATURE_PACKED_FREE_MAP;
+        fileManager.beginTransaction();
+        fileManager.writeFreeMapWords(spaceManager.getWords(), freeMapOffset);
+        fileManager.writeHeader(header);
+        fileManager.commitTransaction();
+        cout << "🧱 Free space map upgraded to the packed format.\n";
+    }
+    // Blocks past the start of version storage lie outside the data region.
+    if (header.file_state_storage_offset > dataStartOffset)
+        spaceManager.reserveFrom(static_cast<int>(
+            (header.file_state_storage_offset - dataStartOffset) / blockSize));
+    startup.freeMap = lap();
+
     userTable.assign(10, UserInfo());
     if (!fileManager.loadUsers(userTable, userTableOffset, 10))
         cerr << "⚠️ Warning: Could not load users.\n";
@@ -300,17 +815,86 @@ bool loadSystem() {
                                      u.role == UserRole::ADMIN);
         }
     }
-
-    
-    vector<FileEntry> entries;
-    fileManager.readFileEntries(entries, metaOffset, K_MAX_META_ENTRIES);
-    fileManager.closeFile();
-
-    dirTree.importFromEntries(entries);
+    startup.users = lap();
+
+    // Only slots below the high-water mark have ever held an entry; older
+    // containers have no mark and no segments, so the whole fixed table is read.
+    metaTable.configure(metaOffset, K_MAX_META_ENTRIES, dataStartOffset, blockSize);
+    size_t liveSlots = K_MAX_META_ENTRIES;
+    if (header.feature_flags & OMNI_FEATURE_META_SEGMENTS) {
+        metaTable.loadChain(fileManager, header.meta_root_block, header.meta_segments);
+        liveSlots = min<size_t>(header.meta_high_water, metaTable.capacity());
+    }
+    dirTree.setSlotCapacity(metaTable.capacity());
+
+    // With an index on disk, the tree queues key changes from here on
+    // (including entries the import drops).
+    const bool hasPathIndex = header.feature_flags & OMNI_FEATURE_PATH_INDEX;
+    pathIndex.configure(&fileManager, &spaceManager, dataStartOffset, blockSize);
+    if (hasPathIndex) pathIndex.attach(header.index_root_block, header.index_levels, header.index_pages);
+    dirTree.trackIndexKeys(hasPathIndex);
+
+    // A lazy load finds children through the path index and reports the
+    // totals saved in the header; containers without either load in full
+    // once, which adds them.
+    const bool parentIndexed = header.feature_flags & OMNI_FEATURE_PARENT_INDEX;
+    const bool segmented = header.feature_flags & OMNI_FEATURE_META_SEGMENTS;
+    startup.lazy = lazyNamespace && hasPathIndex && parentIndexed && segmented &&
+                   (header.feature_flags & OMNI_FEATURE_TREE_COUNTS);
+    if (startup.lazy) {
+        TreeCounts saved;
+        saved.files = header.tree_files;
+        saved.directories = header.tree_directories;
+        saved.fragmentedFiles = header.tree_fragmented;
+        saved.extents = header.tree_extents;
+        dirTree.startLazy(header.meta_high_water, saved);
+        startup.metaRead = lap();
+        cout << "💤 Namespace is paged in on demand (" << header.meta_high_water << " slots on disk).\n";
+    } else {
+        vector<FileEntry> entries;
+        startup.readers = loadThreads ? loadThreads : max(1u, thread::hardware_concurrency());
+        metaTable.readSlots(fileManager, liveSlots, entries, startup.readers);
+        startup.entries = entries.size();
+        startup.metaRead = lap();
+        cout << "📂 Directory metadata read successfully.\n";
+
+        // Legacy full-path entries are converted to the parent-index format.
+        dirTree.importFromEntries(entries, parentIndexed);
+        startup.import = lap();
+        startup.tree = dirTree.lastImportTimings();
+        if (!parentIndexed || !segmented) {
+            header.feature_flags |= OMNI_FEATURE_PARENT_INDEX | OMNI_FEATURE_META_SEGMENTS;
+            header.meta_root_block = 0;
+            header.meta_segments = 0;
+            header.meta_high_water = dirTree.slotHighWater();
+            if (!parentIndexed) dirTree.markAllDirty();
+            fileManager.beginTransaction();
+            persistEntries();
+            fileManager.writeHeader(header);
+            fileManager.commitTransaction();
+            if (!parentIndexed) cout << "🗂️ Metadata upgraded to the parent-index format.\n";
+        }
+        if (!hasPathIndex) buildPathIndex();
+        startup.upgrade = lap();
+
+        // Files behind an extent map are counted from the map's run list.
+        dirTree.forEachFile([&](FileNode* node) {
+            if (node->blocks.count != EXTENT_MAP_MARKER) return;
+            vector<Extent> runs;
+            if (resolveExtents(node->blocks, runs))
+                dirTree.setExtentCount(node, static_cast<uint32_t>(runs.size()));
+        });
+        if (publishTreeCounts()) {
+            fileManager.beginTransaction();
+            fileManager.writeHeader(header);
+            fileManager.commitTransaction();
+        }
+        startup.extents = lap();
+    }
 
     isInitialized = true;
     updateStats();
-    cout << "✅ Directory tree rebuilt from saved metadata.\n";
+    if (!startup.lazy) cout << "✅ Directory tree rebuilt from saved metadata.\n";
 
 
 
@@ -323,12 +907,14 @@ bool loadSystem() {
             dirTree.createUserHome(u.username);
     }
 
-
+    startup.total = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    printStartupTimings();
     return true;
 }
 
  
 bool readFileContent(uint32_t blockIndex, uint32_t dataLength = 256) {
+    auto guard = foreground();
     if (!session || !session->isLoggedIn()) {
         cerr << "❌ Access Denied: You must be logged in to read files.\n";
         return false;
@@ -336,17 +922,20 @@ bool readFileContent(uint32_t blockIndex, uint32_t dataLength = 256) {
 
     cout << "📖 Reading data as user: " << session->getCurrentUser() << endl;
 
-    if (!fileManager.openFile(omniFileName, 4096)) {
+    if (!ensureOpen()) {
         cerr << "❌ Could not open .omni file.\n";
         return false;
     }
 
-    vector<char> buffer;
-    fileManager.readFileData(dataStartOffset, blockIndex, 4096, buffer);
-    fileManager.closeFile();
-
-    
-    string content(buffer.data(), buffer.data() + strnlen(buffer.data(), buffer.size()));
+    // Mapped containers are read in place; otherwise copy the block out.
+    string content;
+    if (const char* view = fileManager.blockView(dataStartOffset, blockIndex, 4096)) {
+        content.assign(view, strnlen(view, 4096));
+    } else {
+        vector<char> buffer;
+        fileManager.readFileData(dataStartOffset, blockIndex, 4096, buffer);
+        content.assign(buffer.data(), strnlen(buffer.data(), buffer.size()));
+    }
 
     cout << "\n📄 === File Content (Block #" << blockIndex << ") ===\n";
     cout << content << "\n";
@@ -356,8 +945,156 @@ bool readFileContent(uint32_t blockIndex, uint32_t dataLength = 256) {
     return true;
 }
 
+// Reads a whole file by path (relative to the user's home), following its
+// extents rather than a single block index.
+bool readFile(const string& relPath) {
+    auto guard = foreground();
+    if (!session || !session->isLoggedIn()) {
+        cerr << "❌ Access Denied: You must be logged in to read files.\n";
+        return false;
+    }
+
+    string full = normalizeUserPath(relPath);
+    FileNode* node = dirTree.findNodeByPath(full);
+    if (!node || !node->isFile) {
+        cerr << "❌ File not found: " << full << endl;
+        return false;
+    }
+
+    string content;
+    if (!readData(node->blocks, node->size, content)) {
+        cerr << "❌ Could not read file data.\n";
+        return false;
+    }
+
+    cout << "\n📄 === " << full << " (" << node->size << " bytes) ===\n";
+    cout << content << "\n";
+    cout << "============================================\n";
+
+    session->recordOperation();
+    return true;
+}
+
+// =====================================================
+//  Handle-based access
+// =====================================================
+// openFile() resolves a path once; reads and writes through the handle
+// then find the node by inode in O(1), with no path walk.
+
+FileHandle openFile(const string& relPath) {
+    auto guard = foreground();
+    if (!session || !session->isLoggedIn()) {
+        cerr << "❌ Access Denied: You must be logged in to open files.\n";
+        return {};
+    }
+
+    string full = normalizeUserPath(relPath);
+    FileNode* node = dirTree.findNodeByPath(full);
+    if (!node || !node->isFile) {
+        cerr << "❌ File not found: " << full << endl;
+        return {};
+    }
+    return dirTree.handleOf(node);
+}
+
+// Resolves an absolute path from disk alone: per component, one path
+// index descent plus one FileEntry read to confirm the name. The
+// in-memory tree is not consulted, so this also serves a cold start.
+bool lookupEntry(const string& fullPath, FileEntry& out) {
+    if (!(header.feature_flags & OMNI_FEATURE_PATH_INDEX) || !ensureOpen()) return false;
+
+    uint32_t parent = 0;
+    vector<uint32_t> candidates;
+    size_t pos = 0;
+    bool found = false;
+    while (pos < fullPath.size()) {
+        size_t next = fullPath.find('/', pos);
+        if (next == string::npos) next = fullPath.size();
+        const string_view name(fullPath.data() + pos, next - pos);
+        pos = next + 1;
+        if (name.empty()) continue;
+        const bool last = fullPath.find_first_not_of('/', next) == string::npos;
+
+        if (!pathIndex.find(parent, indexNameHash(name.data(), name.size()), candidates)) return false;
+        found = false;
+        for (uint32_t inode : candidates) {
+            if (inode == 0 || inode > metaTable.capacity()) continue;
+            FileEntry e;
+            if (!fileManager.readFileEntry(e, metaTable.offsetOf(inode - 1))) continue;
+            if (e.inode != inode || e.parent_inode != parent ||
+                name != string_view(e.name, strnlen(e.name, sizeof(e.name))))
+                continue;
+            if (!last && e.type != 1) continue;
+            out = e;
+            found = true;
+            break;
+        }
+        if (!found) return false;
+        parent = out.inode;
+    }
+    return found;
+}
+
+// STAT: the entry at a user path, looked up through the path index.
+bool statPath(const string& relPath, FileEntry& out) {
+    auto guard = foreground();
+    if (!session || !session->isLoggedIn()) {
+        cerr << "❌ Access Denied: You must be logged in to stat files.\n";
+        return false;
+    }
+    string full = normalizeUserPath(relPath);
+    if (!lookupEntry(full, out)) {
+        cerr << "❌ Not found: " << full << endl;
+        return false;
+    }
+    session->recordOperation();
+    return true;
+}
+
+bool readFileByHandle(const FileHandle& h, string& out) {
+    auto guard = foreground();
+    FileNode* node = handleNode(h);
+    if (!node) return false;
+
+    if (!readData(node->blocks, node->size, out)) {
+        cerr << "❌ Could not read file data.\n";
+        return false;
+    }
+    session->recordOperation();
+    return true;
+}
+
+// Replaces the file's content in place: the inode, and so every open
+// handle, stays valid. Old blocks stay with the file's earlier versions.
+bool writeFileByHandle(const FileHandle& h, const string& content) {
+    auto guard = foreground();
+    FileNode* node = handleNode(h);
+    if (!node) return false;
+
+    const string full = dirTree.pathOf(node);
+    const string home = "/home/" + session->getCurrentUser();
+    const string logPath = full.compare(0, home.size() + 1, home + "/") == 0 ? full.substr(home.size()) : full;
+
+    fileManager.beginTransaction();
+    Extent root{0, 0};
+    uint32_t runs = 0;
+    if (!writeFileContent(logPath, content, &root, &runs)) {
+        fileManager.abortTransaction();
+        cerr << "❌ Failed to write file at: " << full << endl;
+        return false;
+    }
+    node->size = content.size();
+    node->blocks = root;
+    dirTree.setExtentCount(node, runs);
+    dirTree.touch(node);
+    persistEntries();
+    fileManager.commitTransaction();
+    return true;
+}
+
    
     void createUser(const string& username, const string& password, bool isAdmin) {
+        auto guard = foreground();
         if (!session || !session->isAdminUser()) {
             cerr << "❌ Access Denied: Only Admin can create new users.\n";
             return;
@@ -377,24 +1114,25 @@ bool readFileContent(uint32_t blockIndex, uint32_t dataLength = 256) {
             }
 
 
-            fileManager.openFile(omniFileName, 4096);
+            ensureOpen();
+            fileManager.beginTransaction();
             fileManager.saveUsers(userTable, userTableOffset);
+            fileManager.commitTransaction();
 
             dirTree.createUserHome(username);
             cout << "🏠 Home directory created for user: /home/" << username << "\n";
 
 
 
-            fileManager.closeFile();
         }
     }
 
 
     void listVersions() {
-        fileManager.openFile(omniFileName, 4096);
+        auto guard = foreground();
+        ensureOpen();
         vector<VersionBlock> versions;
         fileManager.readAllVersions(versions, header.file_state_storage_offset);
-        fileManager.closeFile();
 
         cout << "\n--- Available Versions (" << versions.size() << ") ---\n";
         if (versions.empty()) {
@@ -410,7 +1148,7 @@ bool readFileContent(uint32_t blockIndex, uint32_t dataLength = 256) {
 
 
     void logChange(const string& path, const string& user, const string& action, uint64_t versionID) {
-        fileManager.openFile(omniFileName, 4096);
+        ensureOpen();
         ChangeLogEntry entry{};
         strncpy(entry.filePath, path.c_str(), sizeof(entry.filePath) - 1);
         strncpy(entry.user, user.c_str(), sizeof(entry.user) - 1);
@@ -418,15 +1156,16 @@ bool readFileContent(uint32_t blockIndex, uint32_t dataLength = 256) {
         entry.timestamp = time(nullptr);
         entry.versionID = versionID;
 
+        fileManager.beginTransaction();
         fileManager.writeChangeLog({entry}, header.change_log_offset);
-        fileManager.closeFile();
+        fileManager.commitTransaction();
     }
 
     void showChangeLog() {
+        auto guard = foreground();
         vector<ChangeLogEntry> log;
-        fileManager.openFile(omniFileName, 4096);
+        ensureOpen();
         fileManager.readChangeLog(log, header.change_log_offset, 10);
-        fileManager.closeFile();
 
         cout << "\n--- Change Log ---\n";
         for (auto& e : log)
@@ -438,15 +1177,20 @@ bool readFileContent(uint32_t blockIndex, uint32_t dataLength = 256) {
 
   
     void revertToVersion(uint64_t versionID) {
+        auto guard = foreground();
         vector<VersionBlock> versions;
-        fileManager.openFile(omniFileName, 4096);
+        ensureOpen();
         fileManager.readAllVersions(versions, header.file_state_storage_offset);
-        fileManager.closeFile();
 
         for (auto& v : versions) {
             if (v.versionID == versionID) {
                 cout << "\nRestoring version " << versionID << " of " << v.filePath << "...\n";
-                readFileContent(v.startBlock, 4096);
+                string content;
+                if (!readData({v.startBlock, v.blockCount}, UINT64_MAX, content)) {
+                    cerr << "❌ Could not read version data.\n";
+                    return;
+                }
+                cout << content << "\n";
                 cout << "✅ Version restored.\n";
                 return;
             }
@@ -454,9 +1198,9 @@ bool readFileContent(uint32_t blockIndex, uint32_t dataLength = 256) {
         cout << "❌ Version ID not found.\n";
     }
 
-void saveFileVersion(const string& path, uint32_t blockIndex) {
+void saveFileVersion(const string& path, const Extent& root) {
     
-    if (!fileManager.openFile(omniFileName, 4096)) {
+    if (!ensureOpen()) {
         cerr << "❌ Could not open .omni to save version.\n";
         return;
     }
@@ -464,11 +1208,9 @@ void saveFileVersion(const string& path, uint32_t blockIndex) {
     OMNIHeader current{};
     
     
-    fileManager.seekToStart();
-    fileManager.File().read(reinterpret_cast<char*>(&current), sizeof(OMNIHeader));
+    fileManager.readHeader(current);
     if (strncmp(current.magic, "OMNIFS01", 8) != 0) {
         cerr << "❌ Header read failed — invalid magic!\n";
-        fileManager.closeFile();
         return;
     }
 
@@ -484,17 +1226,15 @@ void saveFileVersion(const string& path, uint32_t blockIndex) {
     memset(&vb, 0, sizeof(vb));
     strncpy(vb.filePath, path.c_str(), sizeof(vb.filePath) - 1);
     vb.versionID  = static_cast<uint64_t>(time(nullptr));
-    vb.startBlock = blockIndex;
-    vb.blockCount = 1;
+    vb.startBlock = root.start;
+    vb.blockCount = root.count;
     vb.timestamp  = vb.versionID;
 
     if (!fileManager.writeVersionBlock(vb, versionOffset)) {
         cerr << "❌ Failed to write version block.\n";
-        fileManager.closeFile();
         return;
     }
 
-    fileManager.closeFile();
     cout << "✅ Saved version for " << path
          << " at offset " << versionOffset
          << " (vID " << vb.versionID << ")\n";
@@ -519,7 +1259,7 @@ void saveFileVersion(const string& path, uint32_t blockIndex) {
     void verifyFileStructure() {
         cout << "🧩 Verifying file structure...\n";
 
-        if (!fileManager.openFile(omniFileName, 4096)) {
+        if (!ensureOpen()) {
             cerr << "❌ Could not open .omni file for verification.\n";
             return;
         }
@@ -527,7 +1267,6 @@ void saveFileVersion(const string& path, uint32_t blockIndex) {
         OMNIHeader verify{};
         if (!fileManager.readHeader(verify)) {
             cerr << "❌ Header could not be read — corrupted file.\n";
-            fileManager.closeFile();
             return;
         }
 
@@ -545,7 +1284,6 @@ void saveFileVersion(const string& path, uint32_t blockIndex) {
 
         if (!headerOK || !versionOK || !blockSizeOK || !totalSizeOK) {
             cerr << "❌ Header verification failed.\n";
-            fileManager.closeFile();
             return;
         }
 
@@ -586,13 +1324,13 @@ void saveFileVersion(const string& path, uint32_t blockIndex) {
                 cout << e.filePath << " | " << e.user << " | " << e.action
                     << " | v" << e.versionID << " | " << ctime((time_t*)&e.timestamp);
 
-        fileManager.closeFile();
         cout << "\n✅ File structure verification complete.\n";
     }
 
 
 
 void listMyFiles() {
+    auto guard = foreground();
     if (!session || !session->isLoggedIn()) {
         cerr << "❌ Login required to list your files.\n";
         return;
@@ -601,6 +1339,7 @@ void listMyFiles() {
 }
 
 void listAllFiles() {
+    auto guard = foreground();
     if (!session || !session->isAdminUser()) {
         cerr << "❌ Admin access required to view all files.\n";
         return;
@@ -608,10 +1347,70 @@ void listAllFiles() {
     dirTree.listAll();
 }
 
+// FIND: streams the nodes under the caller's scope that pass `query` to
+// `sink`, in batches of up to K_FIND_BATCH. Admins search the whole tree,
+// or one user's home with `owner`; everyone else searches their own home.
+// The search runs in rounds under stateLock (DirectoryTree::find), and the
+// sink only runs between rounds, so a slow client stalls nobody else.
+bool findFiles(const FindQuery& query, const string& owner,
+               const function<bool(vector<FindMatch>&)>& sink, size_t& found) {
+    found = 0;
+    FindCursor cursor;
+    string scope;
+    {
+        auto guard = foreground();
+        if (!session || !session->isLoggedIn()) {
+            cerr << "❌ Login required to search files.\n";
+            return false;
+        }
+        const string user = session->getCurrentUser();
+        if (!owner.empty() && owner != user && !session->isAdminUser()) {
+            cerr << "❌ Access Denied: only admins can search another user's files.\n";
+            return false;
+        }
+        scope = !owner.empty() ? "/home/" + owner
+              : session->isAdminUser() ? "/" : "/home/" + user;
+        FileNode* start = dirTree.findNodeByPath(scope);
+        if (!start || start->isFile) {
+            cerr << "❌ Directory not found: " << scope << endl;
+            return false;
+        }
+        cursor = dirTree.findFrom(start);
+        session->recordOperation();
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    vector<FindMatch> matches, batch;
+    bool more = true;
+    while (more) {
+        {
+            auto guard = foreground();
+            dirTree.find(cursor, query, matches);
+        }
+        for (size_t b = 0; b < matches.size() && more; b += K_FIND_BATCH) {
+            const auto first = matches.begin() + b;
+            const auto last = matches.begin() + min(matches.size(), b + K_FIND_BATCH);
+            batch.assign(make_move_iterator(first), make_move_iterator(last));
+            found += batch.size();
+            more = sink(batch);
+        }
+        more = more && !cursor.done();
+    }
+
+    ostringstream out;
+    out << "🔎 FIND " << query.pattern << " under " << scope << ": " << found << " match(es) in "
+        << fixed << setprecision(2) << chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count()
+        << " ms\n";
+    auto guard = foreground();      // captureOutput() swaps cout's buffer under it
+    cout << out.str();
+    return true;
+}
+
 
 
 
 void createDirectory(const string& path) {
+    auto guard = foreground();
     if (!session || !session->isLoggedIn()) {
         cerr << "❌ Login required to create directory.\n";
         return;
@@ -625,6 +1424,11 @@ void createDirectory(const string& path) {
     string name   = full.substr(pos + 1);
 
     if (dirTree.createDirectory(parent, name)) {
+        if (ensureOpen()) {
+            fileManager.beginTransaction();
+            persistEntries();
+            fileManager.commitTransaction();
+        }
         cout << "📁 Directory created at: " << full << endl;
     } else {
         cerr << "⚠️ Failed to create directory at " << full << endl;
@@ -635,6 +1439,7 @@ void createDirectory(const string& path) {
 
 
 void createFile(const string& relativePath, const string& content) {
+    auto guard = foreground();
     if (!session || !session->isLoggedIn()) {
         cerr << "❌ Login required to create file.\n";
         return;
@@ -650,20 +1455,40 @@ void createFile(const string& relativePath, const string& content) {
     // Ensure directory exists using your logic
     dirTree.createDirectoryRecursive(parent);
 
+    // Checked before any block is written, so a clash leaks nothing.
+    if (dirTree.findNodeByPath(full)) {
+        cerr << "❌ Name already in use: " << full << endl;
+        return;
+    }
+
+    // Data, free map, version and metadata commit as one transaction.
+    fileManager.beginTransaction();
+
     // Write the content
-    if (writeFileContent("/" + full.substr(6 + session->getCurrentUser().size()), content)) {
+    Extent root{0, 0};
+    uint32_t runs = 0;
+    if (writeFileContent("/" + full.substr(6 + session->getCurrentUser().size()), content, &root, &runs)) {
 
         // Register inside directory tree
-        dirTree.createFile(parent, fileName, content);
+        if (!dirTree.createFile(parent, fileName, content.size(), root, runs)) {
+            releaseData(root);
+            fileManager.abortTransaction();
+            cerr << "❌ Failed to create file at: " << full << endl;
+            return;
+        }
+        persistEntries();
+        fileManager.commitTransaction();
 
         cout << "✅ File created successfully at: " << full << endl;
 
     } else {
+        fileManager.abortTransaction();
         cerr << "❌ Failed to create file at: " << full << endl;
     }
 }
 
     void showMyDirectoryTree() {
+        auto guard = foreground();
         if (!session || !session->isLoggedIn()) {
             cerr << "❌ Login required to view directory tree.\n";
             return;
@@ -673,32 +1498,31 @@ void createFile(const string& relativePath, const string& content) {
     }
 
     void saveSystemState() {
+        auto guard = foreground();
     cout << "\n💾 Saving OFS system state...\n";
-    fileManager.openFile(omniFileName, 4096);
+    ensureOpen();
 
     
-    vector<FileEntry> entries;
-    dirTree.exportToEntries(entries);
-    fileManager.writeFileEntries(entries, sizeof(OMNIHeader) + (10 * sizeof(UserInfo)) + totalBlocks);
+    fileManager.beginTransaction();
+    persistEntries();
     cout << "📂 Directory metadata written successfully.\n";
 
     
-    vector<bool> freeMap = spaceManager.getMap();
-    fileManager.writeFreeMap(freeMap, sizeof(OMNIHeader) + (10 * sizeof(UserInfo)));
+    persistFreeMap();
     cout << "🧱 Free space map written.\n";
 
     
     fileManager.saveUsers(userTable, userTableOffset);
+    fileManager.commitTransaction();
     cout << "✅ Saved " << userTable.size() << " users to .omni file.\n";
 
-    fileManager.closeFile();
-    cout << "🧹 Closed .omni file: " << omniFileName << "\n";
     cout << "✅ OFS state saved successfully.\n";
 }
 
 
 
 bool deleteFile(const string& relPath) {
+    auto guard = foreground();
     if (!session || !session->isLoggedIn()) {
         cerr << "❌ Login required to delete files.\n";
         return false;
@@ -708,13 +1532,10 @@ bool deleteFile(const string& relPath) {
 
     if (dirTree.deleteFile(full)) {
 
-        vector<FileEntry> entries;
-        dirTree.exportToEntries(entries);
-
-        fileManager.openFile(omniFileName, 4096);
-        fileManager.writeFileEntries(entries,
-            header.header_size + (10 * sizeof(UserInfo)) + totalBlocks);
-        fileManager.closeFile();
+        ensureOpen();
+        fileManager.beginTransaction();
+        persistEntries();
+        fileManager.commitTransaction();
 
         updateStats();
         cout << "🗑️  File deleted: " << full << endl;
@@ -726,7 +1547,36 @@ bool deleteFile(const string& relPath) {
 }
 
 
+// Renames or moves a file or directory inside the caller's home. Only the
+// moved node's metadata entry is rewritten.
+bool renamePath(const string& fromRel, const string& toRel) {
+    auto guard = foreground();
+    if (!session || !session->isLoggedIn()) {
+        cerr << "❌ Login required to rename.\n";
+        return false;
+    }
+
+    string from = normalizeUserPath(fromRel);
+    string to = normalizeUserPath(toRel);
+
+    if (!dirTree.renameNode(from, to)) {
+        cerr << "❌ Rename failed: " << from << " -> " << to << endl;
+        return false;
+    }
+
+    ensureOpen();
+    fileManager.beginTransaction();
+    persistEntries();
+    fileManager.commitTransaction();
+
+    session->recordOperation();
+    cout << "✏️ Renamed " << from << " -> " << to << endl;
+    return true;
+}
+
+
 bool deleteDirectory(const string& relPath) {
+    auto guard = foreground();
     if (!session || !session->isLoggedIn()) {
         cerr << "❌ Login required to delete directories.\n";
         return false;
@@ -736,13 +1586,10 @@ bool deleteDirectory(const string& relPath) {
 
     if (dirTree.deleteDirectoryRecursive(full)) {
 
-        vector<FileEntry> entries;
-        dirTree.exportToEntries(entries);
-
-        fileManager.openFile(omniFileName, 4096);
-        fileManager.writeFileEntries(entries,
-            header.header_size + (10 * sizeof(UserInfo)) + totalBlocks);
-        fileManager.closeFile();
+        ensureOpen();
+        fileManager.beginTransaction();
+        persistEntries();
+        fileManager.commitTransaction();
 
         updateStats();
         cout << "🗑️  Directory deleted: " << full << endl;
@@ -754,6 +1601,161 @@ bool deleteDirectory(const string& relPath) {
 }
 
 
+// =====================================================
+//  Online defragmentation
+// =====================================================
+
+// Admin entry point. Relocates every fragmented file into one contiguous
+// run on a background thread; returns false if a run is already going.
+bool startDefrag() {
+    auto guard = foreground();
+    if (!session || !session->isAdminUser()) {
+        cerr << "❌ Access Denied: Only Admin can defragment the file system.\n";
+        return false;
+    }
+    if (!isInitialized || dataStartOffset == 0) {
+        cerr << "⚠️ Load or format the OFS before defragmenting.\n";
+        return false;
+    }
+    if (!defrag.start([this] { defragment(); })) {
+        cerr << "⚠️ Defragmentation already running.\n";
+        return false;
+    }
+    cout << "🧩 Defragmentation started.\n";
+    return true;
+}
+
+void stopDefrag() { defrag.stop(); }
+
+// Synchronous form of startDefrag (no admin check; used by tools).
+void defragment() {
+    vector<FileHandle> files;
+    {
+        lock_guard<recursive_mutex> guard(stateLock);
+        dirTree.forEachFile([&](FileNode* node) {
+            if (node->extents > 1 && node->inode) files.push_back(dirTree.handleOf(node));
+        });
+    }
+    defrag.addCandidates(static_cast<uint32_t>(files.size()));
+
+    for (const auto& h : files) {
+        if (defrag.stopRequested()) break;
+        uint32_t moved = relocateFile(h);
+        if (moved) defrag.addRelocated(moved);
+        else defrag.addSkipped();
+    }
+}
+
+void printDefragStatus() {
+    DefragReport r = defrag.lastReport();
+    cout << "\n--- Defragmenter ---\n";
+    cout << "State: " << (r.running ? "running" : "idle")
+         << " | Candidates: " << r.candidates
+         << " | Relocated: " << r.relocated
+         << " | Skipped: " << r.skipped << "\n";
+    cout << "Blocks Moved: " << r.blocksMoved;
+    if (!r.running && r.seconds > 0) cout << " | Last Run: " << r.seconds << " s";
+    cout << "\n";
+}
+
+private:
+// Resolves a handle for the current session: the file must still exist
+// and, for non-admins, live under the caller's home.
+FileNode* handleNode(const FileHandle& h) {
+    if (!session || !session->isLoggedIn()) {
+        cerr << "❌ Access Denied: You must be logged in to use file handles.\n";
+        return nullptr;
+    }
+    FileNode* node = dirTree.resolve(h);
+    if (!node || !node->isFile) {
+        cerr << "❌ Stale file handle: " << h.inode << ":" << h.generation << endl;
+        return nullptr;
+    }
+    const string home = "/home/" + session->getCurrentUser() + "/";
+    if (!session->isAdminUser() && dirTree.pathOf(node).compare(0, home.size(), home) != 0) {
+        cerr << "❌ Access Denied: handle is outside your home directory.\n";
+        return nullptr;
+    }
+    return node;
+}
+
+// Moves one file's data into a single run. The copy runs in chunks, each
+// under stateLock and followed by a throttle pause; the switch-over
+// (FileEntry, every VersionBlock with the old root, free map) is one
+// transaction. Returns the blocks moved, 0 if the file was skipped.
+uint32_t relocateFile(const FileHandle& h) {
+    const uint64_t blockSize = header.block_size;
+    Extent oldRoot{0, 0}, target{0, 0};
+    vector<Extent> runs;
+    uint32_t total = 0;
+
+    auto owns = [&] {
+        FileNode* n = dirTree.resolve(h);
+        return n && n->isFile && n->blocks.start == oldRoot.start && n->blocks.count == oldRoot.count;
+    };
+    auto abandon = [&] {
+        lock_guard<recursive_mutex> guard(stateLock);
+        spaceManager.freeRun(target.start, target.count);
+        return 0u;
+    };
+
+    {
+        lock_guard<recursive_mutex> guard(stateLock);
+        FileNode* node = dirTree.resolve(h);
+        if (!node || !node->isFile || node->extents < 2) return 0;
+        oldRoot = node->blocks;
+        if (!ensureOpen() || !resolveExtents(oldRoot, runs) || runs.size() < 2) return 0;
+        for (const auto& e : runs) total += e.count;
+        if (!spaceManager.allocateRun(total, target)) return 0;
+    }
+
+    const uint32_t chunk = max<uint32_t>(1, defrag.options().chunkBlocks);
+    uint32_t copied = 0;
+    for (const auto& e : runs) {
+        for (uint32_t off = 0; off < e.count; off += chunk) {
+            const uint32_t n = min(chunk, e.count - off);
+            {
+                // Hold the lock so the chunk cannot interleave with a
+                // foreground operation; the guard is released before pacing.
+                unique_lock<recursive_mutex> guard(stateLock);
+                if (!owns() || !fileManager.copyBlocks(dataStartOffset, e.start + off,
+                                                       target.start + copied, n, blockSize)) {
+                    guard.unlock();
+                    return abandon();
+                }
+            }
+            copied += n;
+            if (!defrag.pace(static_cast<uint64_t>(n) * blockSize)) return abandon();
+        }
+    }
+
+    unique_lock<recursive_mutex> guard(stateLock);
+    FileNode* node = dirTree.resolve(h);
+    if (!owns()) {
+        guard.unlock();
+        return abandon();
+    }
+
+    // The copy must be on disk before anything points at it.
+    fileManager.flushToDisk();
+    fileManager.beginTransaction();
+    node->blocks = target;
+    dirTree.setExtentCount(node, 1);
+    dirTree.touch(node);
+    persistEntries();
+    fileManager.rewriteVersionRoots(header.file_state_storage_offset, oldRoot, target);
+    spaceManager.freeExtents(runs);
+    spaceManager.freeRun(oldRoot.start, 1);  // the extent map block
+    persistFreeMap();
+    fileManager.commitTransaction();
+    // Freed blocks must not keep cached copies around until they are reused.
+    for (const auto& e : runs) fileManager.blockCache().invalidateRange(e.start, e.count);
+    fileManager.blockCache().invalidateRange(oldRoot.start, 1);
+    return total;
+}
+
+public:
+
 string normalizeUserPath(const string& relPath) {
     if (!session || !session->isLoggedIn())
         return "";
@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace std;
+
+// Pool of aligned scratch buffers for O_DIRECT I/O.
+//
+// O_DIRECT needs the user buffer, file offset and length aligned to the
+// device's logical block size. Requests up to bufferSize reuse pooled
+// buffers; larger ones (multi-block extents) get a one-off allocation that
+// is freed on release.
+class AlignedBufferPool {
+    size_t alignment;
+    size_t bufferSize;
+    size_t maxIdle;
+    vector<char*> idle;
+    mutex lock;
+
+    char* allocate(size_t size) {
+        void* p = nullptr;
+        if (posix_memalign(&p, alignment, size) != 0) return nullptr;
+        return static_cast<char*>(p);
+    }
+
+public:
+    // RAII handle: returns the buffer to the pool when it goes out of scope.
+    class Buffer {
+        AlignedBufferPool* pool;
+        char* ptr;
+        size_t size;
+    public:
+        Buffer(AlignedBufferPool* p, char* b, size_t n) : pool(p), ptr(b), size(n) {}
+        Buffer(Buffer&& o) noexcept : pool(o.pool), ptr(o.ptr), size(o.size) { o.ptr = nullptr; }
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        ~Buffer() { if (ptr) pool->release(ptr, size); }
+
+        char* data() const { return ptr; }
+        explicit operator bool() const { return ptr != nullptr; }
+    };
+
+    AlignedBufferPool(size_t align = 4096, size_t bufSize = 4096, size_t idleLimit = 64)
+        : alignment(align), bufferSize(bufSize), maxIdle(idleLimit) {}
+
+    ~AlignedBufferPool() {
+        for (char* p : idle) free(p);
+    }
+
+    void configure(size_t align, size_t bufSize) {
+        lock_guard<mutex> g(lock);
+        for (char* p : idle) free(p);
+        idle.clear();
+        alignment = align;
+        bufferSize = bufSize;
+    }
+
+    size_t align() const { return alignment; }
+
+    Buffer acquire(size_t size) {
+        if (size > bufferSize) return Buffer(this, allocate(size), size);
+
+        {
+            lock_guard<mutex> g(lock);
+            if (!idle.empty()) {
+                char* p = idle.back();
+                idle.pop_back();
+                return Buffer(this, p, bufferSize);
+            }
+        }
+        return Buffer(this, allocate(bufferSize), bufferSize);
+    }
+
+    void release(char* p, size_t size) {
+        if (size == bufferSize) {
+            lock_guard<mutex> g(lock);
+            if (idle.size() < maxIdle) {
+                idle.push_back(p);
+                return;
+            }
+        }
+        free(p);
+    }
+};
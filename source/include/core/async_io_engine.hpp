@@ -0,0 +1,268 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * One queued read or write.
+ * onComplete receives the bytes transferred, or -errno on failure.
+ */
+struct AsyncIORequest {
+    bool isWrite;
+    int fd;
+    char* buf;
+    size_t len;
+    uint64_t offset;
+    function<void(ssize_t)> onComplete;
+};
+
+// Batched asynchronous I/O on top of io_uring, driven through the raw
+// io_uring_setup / io_uring_enter syscalls (no liburing dependency).
+//
+// run() keeps up to `depth` requests in flight and reaps completions as they
+// arrive, so a batch of N block writes costs one or two io_uring_enter calls
+// instead of N pwrite calls. If the kernel refuses io_uring (old kernel,
+// seccomp), init() fails and run() executes the same requests synchronously.
+class AsyncIOEngine {
+    atomic<int> ringFd{-1};
+    unsigned depth = 0;
+
+    void* sqRing = nullptr;
+    size_t sqRingLen = 0;
+    void* cqRing = nullptr;
+    size_t cqRingLen = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesLen = 0;
+
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    mutex ringLock;
+
+    static int sysSetup(unsigned entries, io_uring_params* p) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+    }
+
+    static int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    // Completes whatever part of a request the kernel did not (short
+    // transfer) or retries it synchronously after EINTR/EAGAIN.
+    static ssize_t finishSync(const AsyncIORequest& r, size_t done) {
+        while (done < r.len) {
+            ssize_t n = r.isWrite
+                ? ::pwrite(r.fd, r.buf + done, r.len - done, static_cast<off_t>(r.offset + done))
+                : ::pread(r.fd, r.buf + done, r.len - done, static_cast<off_t>(r.offset + done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return -errno;
+            }
+            if (n == 0) break;  // EOF on read
+            done += static_cast<size_t>(n);
+        }
+        return static_cast<ssize_t>(done);
+    }
+
+    // Kernels before 5.6 fail IORING_OP_READ/WRITE with -EINVAL. Once a
+    // request failing that way succeeds synchronously, run() stops using
+    // the ring.
+    atomic<bool> rwUnsupported{false};
+
+    // Returns the request's final result.
+    ssize_t complete(const AsyncIORequest& r, ssize_t res) {
+        if (res == -EINVAL) {
+            res = finishSync(r, 0);
+            if (res >= 0) rwUnsupported = true;
+        } else if (res == -EINTR || res == -EAGAIN) {
+            res = finishSync(r, 0);
+        } else if (res > 0 && static_cast<size_t>(res) < r.len) {
+            res = finishSync(r, static_cast<size_t>(res));
+        }
+        if (r.onComplete) r.onComplete(res);
+        return res;
+    }
+
+    // Unmaps and closes the ring; the caller holds ringLock.
+    void teardown() {
+        if (ringFd < 0) return;
+        ::munmap(sqes, sqesLen);
+        if (cqRing != sqRing) ::munmap(cqRing, cqRingLen);
+        ::munmap(sqRing, sqRingLen);
+        ::close(ringFd);
+        ringFd = -1;
+        sqRing = cqRing = nullptr;
+        sqes = nullptr;
+    }
+
+public:
+    AsyncIOEngine() = default;
+    ~AsyncIOEngine() { shutdown(); }
+
+    AsyncIOEngine(const AsyncIOEngine&) = delete;
+    AsyncIOEngine& operator=(const AsyncIOEngine&) = delete;
+
+    bool ready() const { return ringFd >= 0 && !rwUnsupported; }
+
+    bool init(unsigned entries = 64) {
+        lock_guard<mutex> g(ringLock);
+        if (ringFd >= 0) return true;
+
+        io_uring_params p{};
+        int fd = sysSetup(entries, &p);
+        if (fd < 0) {
+            cerr << "⚠️ io_uring unavailable (" << strerror(errno) << "), using synchronous I/O.\n";
+            return false;
+        }
+        ringFd = fd;
+
+        sqRingLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqRingLen = cqRingLen = max(sqRingLen, cqRingLen);
+
+        sqRing = ::mmap(nullptr, sqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd, IORING_OFF_SQ_RING);
+        cqRing = single ? sqRing
+                        : ::mmap(nullptr, cqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 ringFd, IORING_OFF_CQ_RING);
+        sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = ::mmap(nullptr, sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd, IORING_OFF_SQES);
+
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || s == MAP_FAILED) {
+            cerr << "⚠️ io_uring ring mapping failed, using synchronous I/O.\n";
+            if (s != MAP_FAILED) ::munmap(s, sqesLen);
+            if (cqRing != MAP_FAILED && cqRing != sqRing) ::munmap(cqRing, cqRingLen);
+            if (sqRing != MAP_FAILED) ::munmap(sqRing, sqRingLen);
+            sqRing = cqRing = nullptr;
+            ::close(ringFd);
+            ringFd = -1;
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(s);
+
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqTail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask  = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqHead  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask  = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes    = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        depth   = p.sq_entries;
+
+        cout << "⚡ io_uring engine ready (queue depth " << depth << ")\n";
+        return true;
+    }
+
+    void shutdown() {
+        lock_guard<mutex> g(ringLock);
+        teardown();
+    }
+
+    // Executes every request and invokes its callback. Returns false if any
+    // request failed.
+    //
+    // SQEs the kernel did not take in one io_uring_enter (a short submit)
+    // are passed to the next. If the ring fails, the unsubmitted SQEs are
+    // taken back off the ring, everything in flight is reaped, since the
+    // kernel may still be using those buffers, and only the requests that
+    // never reached the kernel are finished synchronously. The ring is then
+    // closed, and later batches run synchronously.
+    bool run(vector<AsyncIORequest>& reqs) {
+        bool ok = true;
+        auto track = [&](AsyncIORequest& r, ssize_t res) {
+            res = complete(r, res);
+            if (res < 0 || (r.isWrite && static_cast<size_t>(res) != r.len)) ok = false;
+        };
+
+        lock_guard<mutex> g(ringLock);
+        if (ringFd < 0 || rwUnsupported) {
+            for (auto& r : reqs) track(r, finishSync(r, 0));
+            return ok;
+        }
+
+        vector<char> finished(reqs.size(), 0);
+        size_t next = 0, inFlight = 0;
+        unsigned unsubmitted = 0;           // published to the SQ, not yet taken by the kernel
+        auto reap = [&] {
+            unsigned head = *cqHead;
+            while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = cqes[head & cqMask];
+                finished[cqe.user_data] = 1;
+                track(reqs[cqe.user_data], cqe.res);
+                ++head;
+                --inFlight;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        };
+
+        while (next < reqs.size() || inFlight > 0 || unsubmitted > 0) {
+            unsigned tail = *sqTail;
+            while (next < reqs.size() && inFlight + unsubmitted < depth) {
+                AsyncIORequest& r = reqs[next];
+                unsigned idx = tail & sqMask;
+                io_uring_sqe& sqe = sqes[idx];
+                memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = r.isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+                sqe.fd = r.fd;
+                sqe.addr = reinterpret_cast<uint64_t>(r.buf);
+                sqe.len = static_cast<uint32_t>(r.len);
+                sqe.off = r.offset;
+                sqe.user_data = next;
+                sqArray[idx] = idx;
+                ++tail;
+                ++next;
+                ++unsubmitted;
+            }
+            __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+            int rc;
+            do {
+                rc = sysEnter(ringFd, unsubmitted, 1, IORING_ENTER_GETEVENTS);
+            } while (rc < 0 && errno == EINTR);
+            if (rc == 0 && inFlight == 0) {     // no progress possible
+                rc = -1;
+                errno = EAGAIN;
+            }
+            if (rc < 0) {
+                cerr << "❌ io_uring_enter failed: " << strerror(errno) << endl;
+                __atomic_store_n(sqTail, *sqTail - unsubmitted, __ATOMIC_RELEASE);
+                unsubmitted = 0;
+                while (inFlight > 0) {
+                    reap();
+                    if (inFlight > 0 && sysEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+                        this_thread::yield();
+                }
+                teardown();
+                for (size_t i = 0; i < reqs.size(); ++i)
+                    if (!finished[i]) track(reqs[i], finishSync(reqs[i], 0));
+                return ok;
+            }
+            inFlight += static_cast<unsigned>(rc);
+            unsubmitted -= static_cast<unsigned>(rc);
+            reap();
+        }
+        return ok;
+    }
+};
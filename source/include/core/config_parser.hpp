@@ -0,0 +1,68 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+// Minimal reader for the .uconf format:
+//
+//   [section]
+//   key = value      # comment
+//
+// Values are looked up as "section.key". Quotes around values are stripped.
+class ConfigParser {
+    unordered_map<string, string> values;
+
+    static string trim(const string& s) {
+        size_t b = s.find_first_not_of(" \t\r");
+        if (b == string::npos) return "";
+        size_t e = s.find_last_not_of(" \t\r");
+        return s.substr(b, e - b + 1);
+    }
+
+public:
+    bool load(const string& path) {
+        ifstream in(path);
+        if (!in.is_open()) {
+            cerr << "⚠️ Config file not found: " << path << " (using defaults)\n";
+            return false;
+        }
+
+        string line, section;
+        while (getline(in, line)) {
+            size_t hash = line.find('#');
+            if (hash != string::npos) line = line.substr(0, hash);
+            line = trim(line);
+            if (line.empty()) continue;
+
+            if (line.front() == '[' && line.back() == ']') {
+                section = trim(line.substr(1, line.size() - 2));
+                continue;
+            }
+
+            size_t eq = line.find('=');
+            if (eq == string::npos) continue;
+            string key = trim(line.substr(0, eq));
+            string val = trim(line.substr(eq + 1));
+            if (val.size() >= 2 && val.front() == '"' && val.back() == '"')
+                val = val.substr(1, val.size() - 2);
+            values[section + "." + key] = val;
+        }
+
+        cout << "⚙️ Loaded config: " << path << endl;
+        return true;
+    }
+
+    string get(const string& key, const string& def = "") const {
+        auto it = values.find(key);
+        return it == values.end() ? def : it->second;
+    }
+
+    uint64_t getInt(const string& key, uint64_t def = 0) const {
+        auto it = values.find(key);
+        if (it == values.end()) return def;
+        try { return stoull(it->second); } catch (...) { return def; }
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+
+using namespace std;
+
+// Tuning for the online defragmenter.
+struct DefragOptions {
+    uint64_t bytesPerSecond = 32ull << 20;  // copy budget (0 = unthrottled)
+    uint32_t chunkBlocks = 64;              // blocks copied per lock hold
+    uint32_t quietMs = 10;                  // foreground idle time required before a chunk
+    uint32_t maxYieldMs = 250;              // longest a chunk waits on a busy foreground
+};
+
+struct DefragReport {
+    bool running = false;
+    uint32_t candidates = 0;    // fragmented files found by the scan
+    uint32_t relocated = 0;     // moved into one contiguous run
+    uint32_t skipped = 0;       // no run large enough, or changed while copying
+    uint64_t blocksMoved = 0;
+    double seconds = 0.0;
+};
+
+// Runs a defrag job on a background thread and paces its I/O.
+//
+// The job itself (OFSCore::defragment) copies data in chunks of
+// chunkBlocks and calls pace() after each one. pace() sleeps until the
+// byte budget allows the next chunk and the foreground has been idle for
+// quietMs, so client requests are never queued behind a long copy.
+class Defragmenter {
+    DefragOptions opts;
+    thread worker;
+    atomic<bool> active{false};
+    atomic<bool> stopFlag{false};
+    atomic<int64_t> lastForegroundMs{0};
+
+    mutex reportLock;
+    DefragReport report;
+
+    chrono::steady_clock::time_point windowStart;
+    uint64_t windowBytes = 0;
+
+    static int64_t nowMs() {
+        return chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    ~Defragmenter() { stop(); }
+
+    void configure(const DefragOptions& o) { opts = o; }
+    const DefragOptions& options() const { return opts; }
+
+    // Called by every foreground operation.
+    void noteForeground() { lastForegroundMs.store(nowMs(), memory_order_relaxed); }
+
+    bool running() const { return active.load(); }
+    bool stopRequested() const { return stopFlag.load(); }
+
+    // Starts job on the worker thread; false if a run is already going.
+    bool start(function<void()> job) {
+        if (active.exchange(true)) return false;
+        if (worker.joinable()) worker.join();
+        {
+            lock_guard<mutex> g(reportLock);
+            report = DefragReport{};
+            report.running = true;
+        }
+        windowStart = chrono::steady_clock::now();
+        windowBytes = 0;
+        worker = thread([this, job] {
+            auto t0 = chrono::steady_clock::now();
+            job();
+            {
+                lock_guard<mutex> g(reportLock);
+                report.running = false;
+                report.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+            }
+            active = false;
+        });
+        return true;
+    }
+
+    // Asks the job to stop after its current chunk and waits for it.
+    void stop() {
+        stopFlag = true;
+        if (worker.joinable()) worker.join();
+        stopFlag = false;
+    }
+
+    // Throttle point between chunks. Returns false once stop() was called.
+    bool pace(uint64_t bytes) {
+        if (stopFlag) return false;
+
+        // Byte budget: sleep off whatever this window is ahead of schedule.
+        windowBytes += bytes;
+        if (opts.bytesPerSecond) {
+            auto due = windowStart + chrono::microseconds(windowBytes * 1000000 / opts.bytesPerSecond);
+            auto now = chrono::steady_clock::now();
+            if (due > now) this_thread::sleep_for(due - now);
+            if (now - windowStart > chrono::seconds(1)) {
+                windowStart = chrono::steady_clock::now();
+                windowBytes = 0;
+            }
+        }
+
+        // Give way to client requests, but never starve the job completely.
+        const int64_t giveUp = nowMs() + opts.maxYieldMs;
+        while (!stopFlag && nowMs() < giveUp &&
+               nowMs() - lastForegroundMs.load(memory_order_relaxed) < opts.quietMs)
+            this_thread::sleep_for(chrono::milliseconds(1));
+
+        return !stopFlag;
+    }
+
+    // Report bookkeeping, called by the job.
+    void addCandidates(uint32_t n) { lock_guard<mutex> g(reportLock); report.candidates += n; }
+    void addRelocated(uint64_t blocks) {
+        lock_guard<mutex> g(reportLock);
+        report.relocated++;
+        report.blocksMoved += blocks;
+    }
+    void addSkipped() { lock_guard<mutex> g(reportLock); report.skipped++; }
+
+    DefragReport lastReport() {
+        lock_guard<mutex> g(reportLock);
+        return report;
+    }
+};
@@ -1,62 +1,621 @@
 #pragma once
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "odf_types.hpp"
+#include "async_io_engine.hpp"
+#include "aligned_buffer_pool.hpp"
+#include "write_ahead_journal.hpp"
+#include "../../data_structures/block_cache.hpp"
 
 using namespace std;
 
+// How FileIOManager talks to the container.
+//  PREAD : positional pread/pwrite on the open descriptor (default)
+//  MMAP  : the whole container is mapped; reads/writes are memcpy into the
+//          mapping and durability comes from explicit msync at commit points
+//  DIRECT: O_DIRECT pread/pwrite through aligned bounce buffers, bypassing
+//          the kernel page cache (falls back to PREAD if the host refuses)
+enum class IOMode { PREAD, MMAP, DIRECT };
+
+// Offset/length/buffer alignment used for O_DIRECT transfers. 4 KiB covers
+// both 512-byte and 4K-sector devices.
+static constexpr uint64_t DIRECT_IO_ALIGN = 4096;
+
+// The .omni container is opened once and kept open for the lifetime of the
+// FileIOManager. Every read/write is positional (pread/pwrite), so there is no
+// shared stream position and concurrent readers never race on a seek.
 class FileIOManager {
-    fstream file;
+    int fd = -1;
     string fileName;
-    uint64_t blockSize;
+    uint64_t blockSize = 4096;
+
+    IOMode mode = IOMode::PREAD;
+    char* mapBase = nullptr;
+    size_t mapLen = 0;
+
+    BlockCache cache;
+
+    bool directOn = false;
+    AlignedBufferPool bufferPool{DIRECT_IO_ALIGN, 4096};
+    mutex directWriteLock;      // serializes read-modify-write of edge sectors
+
+    // Writes issued between beginTransaction() and commitTransaction() on
+    // one thread. When `capture` is set they are queued here, journaled as
+    // one record and then written home (through io_uring if enabled).
+    struct Transaction {
+        const FileIOManager* owner;
+        int depth;
+        bool capture;
+        bool aborted;                               // see abortTransaction()
+        vector<WriteAheadJournal::Write> writes;   // (offset, bytes), in order
+    };
+    inline static thread_local Transaction* activeTxn = nullptr;
+    AsyncIOEngine engine;
+    WriteAheadJournal journal;
+
+    // Journaled transactions not yet written home, by sequence number. Reads
+    // overlay them, and finishCommits() writes them home in sequence order.
+    // A thread only adds entries while it holds the caller's state lock;
+    // `ownCommits` lists the ones it still has to finish.
+    map<uint64_t, vector<WriteAheadJournal::Write>> committed;
+    shared_mutex committedLock;
+    condition_variable_any committedCv;
+    atomic<size_t> committedCount{0};
+    inline static thread_local vector<pair<const FileIOManager*, uint64_t>> ownCommits;
+    inline static thread_local const FileIOManager* deferOwner = nullptr;
+
+    Transaction* txnFor() const {
+        return (activeTxn && activeTxn->owner == this) ? activeTxn : nullptr;
+    }
+
+    Transaction* capturingTxn() const {
+        Transaction* t = txnFor();
+        return (t && t->capture) ? t : nullptr;
+    }
+
+    // Writes queued writes to their home locations. io_uring runs a batch
+    // unordered, so overlapping writes go out in separate submissions.
+    bool applyWrites(vector<WriteAheadJournal::Write>& writes) {
+        if (!engine.ready() || mapBase || directOn) {
+            bool ok = true;
+            for (auto& w : writes) ok = writeHome(w.second.data(), w.second.size(), w.first) && ok;
+            return ok;
+        }
+
+        bool ok = true;
+        vector<AsyncIORequest> reqs;
+        auto submit = [&] {
+            if (!reqs.empty() && !engine.run(reqs)) {
+                cerr << "❌ Batched write failed.\n";
+                ok = false;
+            }
+            reqs.clear();
+        };
+        for (auto& w : writes) {
+            for (const auto& r : reqs)
+                if (w.first < r.offset + r.len && r.offset < w.first + w.second.size()) {
+                    submit();
+                    break;
+                }
+            reqs.push_back({true, fd, w.second.data(), w.second.size(), w.first, nullptr});
+        }
+        submit();
+        return ok;
+    }
+
+    // Without capture the writes already went home and cannot be taken
+    // back; they only touched blocks no committed metadata points at.
+    void discardTransaction(Transaction* t) {
+        if (!t->writes.empty()) cache.clear();
+        const bool capture = t->capture;
+        delete t;
+        if (!capture) sync();
+    }
+
+    // Home data plus the kernel page cache made durable (journal checkpoint).
+    bool flushHome() {
+        if (mapBase && ::msync(mapBase, mapLen, MS_SYNC) != 0) {
+            cerr << "❌ msync failed: " << strerror(errno) << endl;
+            return false;
+        }
+        if (::fdatasync(fd) != 0) {
+            cerr << "❌ fdatasync failed: " << strerror(errno) << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // =====================================================
+    //  Mapping helpers (MMAP mode only)
+    // =====================================================
+    bool mapContainer() {
+        unmapContainer();
+        if (fd < 0 || mode != IOMode::MMAP) return false;
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size <= 0) return false;
+
+        void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size),
+                         PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            cerr << "⚠️ mmap failed (" << strerror(errno) << "), falling back to pread/pwrite.\n";
+            mode = IOMode::PREAD;
+            return false;
+        }
+        mapBase = static_cast<char*>(p);
+        mapLen = static_cast<size_t>(st.st_size);
+        cout << "🗺️ Mapped " << fileName << " (" << mapLen / 1024 << " KB)\n";
+        return true;
+    }
+
+    void unmapContainer() {
+        if (mapBase) {
+            ::msync(mapBase, mapLen, MS_SYNC);
+            ::munmap(mapBase, mapLen);
+            mapBase = nullptr;
+            mapLen = 0;
+        }
+    }
+
+    // =====================================================
+    //  Positional I/O helpers (retry on EINTR / short I/O)
+    // =====================================================
+    size_t rawRead(char* p, size_t len, uint64_t offset) const {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::pread(fd, p + done, len - done, static_cast<off_t>(offset + done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cerr << "❌ pread failed at offset " << offset + done << ": " << strerror(errno) << endl;
+                break;
+            }
+            if (n == 0) break;  // EOF
+            done += static_cast<size_t>(n);
+        }
+        return done;
+    }
+
+    bool rawWrite(const char* p, size_t len, uint64_t offset) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::pwrite(fd, p + done, len - done, static_cast<off_t>(offset + done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cerr << "❌ pwrite failed at offset " << offset + done << ": " << strerror(errno) << endl;
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // =====================================================
+    //  O_DIRECT helpers (DIRECT mode only)
+    // =====================================================
+    bool setDirect(bool on) {
+        directOn = false;
+        if (fd < 0) return false;
+
+        int flags = ::fcntl(fd, F_GETFL);
+        if (!on) {
+            ::fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+            return true;
+        }
+        if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_DIRECT) != 0) {
+            cerr << "⚠️ O_DIRECT rejected by host filesystem (" << strerror(errno)
+                 << "), falling back to pread/pwrite.\n";
+            mode = IOMode::PREAD;
+            return false;
+        }
+        bufferPool.configure(DIRECT_IO_ALIGN, max<uint64_t>(blockSize, DIRECT_IO_ALIGN));
+        directOn = true;
+        cout << "🎯 O_DIRECT enabled on " << fileName << endl;
+        return true;
+    }
+
+    // Some filesystems accept the flag but fail the first transfer.
+    void dropDirect() {
+        cerr << "⚠️ O_DIRECT transfer rejected, falling back to pread/pwrite.\n";
+        setDirect(false);
+        mode = IOMode::PREAD;
+    }
+
+    static uint64_t alignDown(uint64_t v) { return v & ~(DIRECT_IO_ALIGN - 1); }
+    static uint64_t alignUp(uint64_t v) { return (v + DIRECT_IO_ALIGN - 1) & ~(DIRECT_IO_ALIGN - 1); }
+
+    size_t directRead(char* dst, size_t len, uint64_t offset) {
+        const uint64_t start = alignDown(offset);
+        const uint64_t end = alignUp(offset + len);
+        auto buf = bufferPool.acquire(end - start);
+        if (!buf) return 0;
+
+        errno = 0;
+        size_t got = rawRead(buf.data(), end - start, start);
+        if (got == 0 && errno == EINVAL) {
+            dropDirect();
+            return rawRead(dst, len, offset);
+        }
+
+        const size_t skip = offset - start;
+        if (got <= skip) return 0;
+        size_t n = min<uint64_t>(len, got - skip);
+        memcpy(dst, buf.data() + skip, n);
+        return n;
+    }
+
+    bool directWrite(const char* src, size_t len, uint64_t offset) {
+        lock_guard<mutex> g(directWriteLock);
+        const uint64_t start = alignDown(offset);
+        const uint64_t end = alignUp(offset + len);
+        auto buf = bufferPool.acquire(end - start);
+        if (!buf) return false;
+
+        // Preserve the bytes around the write in the first and last sector.
+        if (offset != start || offset + len != end) {
+            memset(buf.data(), 0, end - start);
+            if (offset != start) rawRead(buf.data(), DIRECT_IO_ALIGN, start);
+            if (offset + len != end)
+                rawRead(buf.data() + (end - start - DIRECT_IO_ALIGN), DIRECT_IO_ALIGN, end - DIRECT_IO_ALIGN);
+        }
+        memcpy(buf.data() + (offset - start), src, len);
+
+        errno = 0;
+        if (rawWrite(buf.data(), end - start, start)) return true;
+        if (errno != EINVAL) return false;
+        dropDirect();
+        return rawWrite(src, len, offset);
+    }
+
+    // =====================================================
+    //  Positional I/O entry points (mapping / O_DIRECT / pread)
+    // =====================================================
+    size_t readHome(void* dst, size_t len, uint64_t offset) {
+        size_t n;
+        if (mapBase) {
+            if (offset >= mapLen) return 0;
+            n = min<uint64_t>(len, mapLen - offset);
+            memcpy(dst, mapBase + offset, n);
+        } else if (directOn) {
+            n = directRead(static_cast<char*>(dst), len, offset);
+        } else {
+            n = rawRead(static_cast<char*>(dst), len, offset);
+        }
+        return n;
+    }
+
+    // Home bytes, then committed writes still on their way home, then the
+    // calling thread's own queued writes. The shared lock keeps an entry
+    // from being dropped between the home read and its overlay.
+    size_t readAt(void* dst, size_t len, uint64_t offset) {
+        char* p = static_cast<char*>(dst);
+        size_t n;
+        if (committedCount == 0) {
+            n = readHome(dst, len, offset);
+        } else {
+            shared_lock<shared_mutex> g(committedLock);
+            n = readHome(dst, len, offset);
+            for (const auto& c : committed) overlayWrites(c.second, p, n, offset);
+        }
+        if (Transaction* t = capturingTxn()) overlayWrites(t->writes, p, n, offset);
+        return n;
+    }
+
+    static void overlayWrites(const vector<WriteAheadJournal::Write>& writes,
+                              char* dst, size_t len, uint64_t offset) {
+        for (const auto& w : writes) {
+            const uint64_t b = max<uint64_t>(offset, w.first);
+            const uint64_t e = min<uint64_t>(offset + len, w.first + w.second.size());
+            if (b < e) memcpy(dst + (b - offset), w.second.data() + (b - w.first), e - b);
+        }
+    }
+
+    bool writeHome(const char* src, size_t len, uint64_t offset) {
+        if (mapBase && offset + len <= mapLen) {
+            memcpy(mapBase + offset, src, len);
+            return true;
+        }
+        if (directOn) return directWrite(src, len, offset);
+        return rawWrite(src, len, offset);
+    }
+
+    bool writeAt(const void* src, size_t len, uint64_t offset) {
+        const char* p = static_cast<const char*>(src);
+        if (Transaction* t = capturingTxn()) {
+            t->writes.emplace_back(offset, vector<char>(p, p + len));
+            return true;
+        }
+
+        // A write outside any transaction must not be undone by replaying an
+        // older journal record for the same bytes.
+        finishCommits();
+        if (journal.active() && !journal.empty()) journal.checkpoint();
+        return writeHome(p, len, offset);
+    }
+
+    // No committed write left on its way home, from any thread.
+    void drainCommits() {
+        finishCommits();
+        shared_lock<shared_mutex> g(committedLock);
+        committedCv.wait(g, [&] { return committed.empty(); });
+    }
+
+    void applyMode() {
+        drainCommits();     // home writes may go through the old mapping
+        if (mode == IOMode::MMAP) mapContainer();
+        else unmapContainer();
+        if (mode == IOMode::DIRECT) setDirect(true);
+        else if (directOn) setDirect(false);
+    }
 
 public:
     FileIOManager() = default;
+    ~FileIOManager() { closeFile(); }
+
+    FileIOManager(const FileIOManager&) = delete;
+    FileIOManager& operator=(const FileIOManager&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    const string& path() const { return fileName; }
+
+    // Switching mode on an open container takes effect immediately.
+    void setMode(IOMode m) {
+        mode = m;
+        if (fd >= 0) applyMode();
+    }
+
+    IOMode getMode() const { return mode; }
+
+    // Write-through cache consulted by readFileData (capacity 0 = off).
+    BlockCache& blockCache() { return cache; }
+
+    // Turns on the io_uring engine; stays synchronous if the host lacks it.
+    bool enableAsyncIO(unsigned queueDepth = 64) { return engine.init(queueDepth); }
+    bool asyncIOReady() const { return engine.ready(); }
+
+    // Groups the writes of one logical operation (data extents, free map,
+    // metadata, version block, ...). Transactions nest; the outermost
+    // commitTransaction() is the commit point:
+    //  - with a journal the writes become one redo record, made durable by a
+    //    group-committed fdatasync, and are then written home
+    //    (finishCommits(); deferred while deferCommits() is on)
+    //  - otherwise they go out as one io_uring submission when the engine
+    //    is on, or straight through, followed by sync()
+    // Reads inside a transaction see its queued writes.
+    void beginTransaction() {
+        if (Transaction* t = txnFor()) { ++t->depth; return; }
+        if (activeTxn) return;
+        finishCommits();
+        const bool capture = journal.active() || (engine.ready() && !mapBase && !directOn);
+        activeTxn = new Transaction{this, 1, capture, false, {}};
+    }
+
+    bool commitTransaction() {
+        Transaction* t = txnFor();
+        if (!t) return sync();
+        if (--t->depth > 0) return true;
+        activeTxn = nullptr;
+        if (t->aborted) {
+            discardTransaction(t);
+            return false;
+        }
+
+        bool ok = true;
+        if (t->capture && !t->writes.empty()) {
+            const uint64_t seq = journal.active() ? journal.append(t->writes) : 0;
+            if (seq) {
+                {
+                    unique_lock<shared_mutex> g(committedLock);
+                    committed.emplace(seq, move(t->writes));
+                    ++committedCount;
+                }
+                ownCommits.emplace_back(this, seq);
+                delete t;
+                return deferOwner == this || finishCommits();
+            }
+            if (journal.active()) drainCommits();  // must not land under an older record
+            ok = applyWrites(t->writes);
+            if (journal.active()) ok = flushHome() && ok;
+        }
+        delete t;
+        if (!journal.active()) ok = sync() && ok;
+        return ok;
+    }
+
+    // While on, this thread's journaled commits return once appended; the
+    // fdatasync and the home writes wait for finishCommits(). The caller
+    // turns it on while holding its state lock and calls finishCommits()
+    // after releasing it, so concurrent operations share one fdatasync.
+    // Others see the committed writes meanwhile (readAt overlays them).
+    void deferCommits(bool on) { deferOwner = on ? this : nullptr; }
+
+    // Makes this thread's outstanding commits durable and writes them home,
+    // after every earlier commit. Also runs before anything that may wait
+    // for a checkpoint, so a thread never waits on its own pending record.
+    bool finishCommits() {
+        bool ok = true;
+        for (size_t i = 0; i < ownCommits.size();) {
+            if (ownCommits[i].first != this) { ++i; continue; }
+            const uint64_t seq = ownCommits[i].second;
+            ownCommits.erase(ownCommits.begin() + i);
+
+            const bool durable = journal.waitDurable(seq);
+            vector<WriteAheadJournal::Write>* writes;
+            {
+                shared_lock<shared_mutex> g(committedLock);
+                committedCv.wait(g, [&] { return committed.begin()->first == seq; });
+                writes = &committed.begin()->second;
+            }
+            bool applied = applyWrites(*writes);
+            if (!durable) applied = flushHome() && applied;
+            ok = ok && applied;
+            journal.applied(seq);
+            {
+                unique_lock<shared_mutex> g(committedLock);
+                committed.erase(seq);
+                --committedCount;
+            }
+            committedCv.notify_all();
+        }
+        return ok;
+    }
+
+    // Ends the transaction without applying it, for failure paths. The
+    // captured writes are dropped, and with them any cached copies made
+    // from them. An abort inside a nested transaction dooms the outer one:
+    // its commitTransaction() discards everything and returns false.
+    void abortTransaction() {
+        Transaction* t = txnFor();
+        if (!t) return;
+        t->aborted = true;
+        if (--t->depth > 0) return;
+        activeTxn = nullptr;
+        discardTransaction(t);
+    }
+
+    // =====================================================
+    //  Write-ahead journal
+    // =====================================================
+    bool formatJournal(uint64_t offset, uint64_t size) {
+        return WriteAheadJournal::format(fd, offset, size);
+    }
+
+    // Replays committed-but-unapplied records, then journals every later
+    // transaction. A container without a journal region keeps working
+    // unjournaled.
+    bool attachJournal(uint64_t offset, uint64_t size) {
+        if (fd < 0 || offset == 0 || size == 0) return false;
+        if (journal.active()) return true;
+        return journal.attach(fd, offset, size,
+            [this] { return flushHome(); },
+            [this](uint64_t off, const char* p, size_t n) { return writeHome(p, n, off); });
+    }
+
+    bool journalActive() const { return journal.active(); }
+    uint64_t journalCommits() const { return journal.commitCount(); }
+    uint64_t journalSyncs() const { return journal.syncCount(); }
+    uint64_t journalCheckpoints() const { return journal.checkpointCount(); }
+
+    // Reads several runs of one file; with the engine they are all in
+    // flight at once, otherwise they are read one after another.
+    bool readExtents(uint64_t dataRegionOffset, const vector<Extent>& extents, uint64_t blockSize,
+                     char* out, size_t len) {
+        if (fd < 0) {
+            cerr << "❌ Error: .omni file not open for read.\n";
+            return false;
+        }
 
+        if (!engine.ready() || mapBase || directOn || capturingTxn() || committedCount > 0 ||
+            extents.size() < 2) {
+            size_t done = 0;
+            for (const auto& e : extents) {
+                if (done >= len) break;
+                size_t n = min<uint64_t>(len - done, static_cast<uint64_t>(e.count) * blockSize);
+                if (!readExtent(dataRegionOffset, e, blockSize, out + done, n)) return false;
+                done += n;
+            }
+            return true;
+        }
 
+        vector<AsyncIORequest> reqs;
+        size_t done = 0;
+        for (const auto& e : extents) {
+            if (done >= len) break;
+            size_t n = min<uint64_t>(len - done, static_cast<uint64_t>(e.count) * blockSize);
+            reqs.push_back({false, fd, out + done, n,
+                            dataRegionOffset + static_cast<uint64_t>(e.start) * blockSize, nullptr});
+            done += n;
+        }
+        return engine.run(reqs);
+    }
+
+    // Commit point for unjournaled containers. In MMAP mode dirty pages only
+    // reach the file on msync; in PREAD mode pwrite has already handed the
+    // data to the kernel.
+    bool sync() {
+        if (mapBase && ::msync(mapBase, mapLen, MS_SYNC) != 0) {
+            cerr << "❌ msync failed: " << strerror(errno) << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Zero-copy view of one data block, or nullptr when the container is not
+    // mapped (callers then fall back to readFileData).
+    const char* blockView(uint64_t dataRegionOffset, uint32_t blockIndex, uint64_t blockSize) const {
+        if (!mapBase || committedCount > 0) return nullptr;
+        uint64_t off = dataRegionOffset + static_cast<uint64_t>(blockIndex) * blockSize;
+        if (off + blockSize > mapLen) return nullptr;
+        return mapBase + off;
+    }
 
     // =====================================================
-    //  Create new .omni file
+    //  Create new .omni file (left open for the caller)
     // =====================================================
     bool createOmniFile(const string& name, uint64_t totalSize, uint64_t blockSize) {
+        closeFile();
+        cache.clear();
         fileName = name;
         this->blockSize = blockSize;
 
-        file.open(fileName, ios::out | ios::binary | ios::trunc);
-        if (!file.is_open()) {
-            cerr << "❌ Error: Could not create " << fileName << endl;
+        fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            cerr << "❌ Error: Could not create " << fileName << ": " << strerror(errno) << endl;
             return false;
         }
 
-        vector<char> zeros(1024, 0);
-        uint64_t written = 0;
-        while (written < totalSize) {
-            file.write(zeros.data(), zeros.size());
-            written += zeros.size();
+        // Size the container without touching the data region: ftruncate
+        // leaves a sparse file whose holes read back as zeros. format() then
+        // writes only the regions it initializes. Hosts that refuse to
+        // extend by truncation get the space reserved with posix_fallocate,
+        // and as a last resort the container is zero-filled.
+        if (::ftruncate(fd, static_cast<off_t>(totalSize)) != 0) {
+            cerr << "⚠️ ftruncate failed (" << strerror(errno) << "), preallocating instead.\n";
+            if (::posix_fallocate(fd, 0, static_cast<off_t>(totalSize)) != 0) {
+                vector<char> zeros(1 << 20, 0);
+                for (uint64_t written = 0; written < totalSize; written += zeros.size()) {
+                    size_t n = min<uint64_t>(zeros.size(), totalSize - written);
+                    if (!writeAt(zeros.data(), n, written)) return false;
+                }
+            }
         }
 
-        file.close();
-
         cout << "✅ Created .omni file: " << fileName
              << " (" << totalSize / 1024 << " KB)" << endl;
+        applyMode();
         return true;
     }
 
     // =====================================================
-    //  Open file for read/write
+    //  Open file for read/write (no-op if already open)
     // =====================================================
     bool openFile(const string& path, uint64_t blockSize) {
-        if (file.is_open()) file.close();
-        file.open(path, ios::in | ios::out | ios::binary);
-        if (!file.is_open()) {
-            cerr << "❌ Could not open file: " << path << endl;
+        this->blockSize = blockSize;
+        if (fd >= 0 && path == fileName) return true;
+
+        closeFile();
+        cache.clear();
+        fd = ::open(path.c_str(), O_RDWR);
+        if (fd < 0) {
+            cerr << "❌ Could not open file: " << path << ": " << strerror(errno) << endl;
             return false;
         }
-        this->blockSize = blockSize;
         fileName = path;
+        applyMode();
         return true;
     }
 
@@ -64,7 +623,7 @@ public:
     //  Write header safely (always from start)
     // =====================================================
     bool writeHeader(const OMNIHeader& header) {
-        if (!file.is_open()) {
+        if (fd < 0) {
             cerr << "❌ File not open for writing header!" << endl;
             return false;
         }
@@ -74,14 +633,11 @@ public:
         cout << " - Total Size: " << header.total_size << "\n";
         cout << " - Version Offset: " << header.file_state_storage_offset << "\n";
 
-        file.seekp(0, ios::beg);
-        file.write(reinterpret_cast<const char*>(&header), sizeof(OMNIHeader));
-        file.flush();
+        if (!writeAt(&header, sizeof(OMNIHeader), 0)) return false;
 
         // Verify header integrity after write
         OMNIHeader verify;
-        file.seekg(0, ios::beg);
-        file.read(reinterpret_cast<char*>(&verify), sizeof(OMNIHeader));
+        readAt(&verify, sizeof(OMNIHeader), 0);
 
         if (strcmp(verify.magic, "OMNIFS01") != 0) {
             cerr << "❌ ERROR: Header verification failed! Magic: '" << verify.magic << "'\n";
@@ -92,20 +648,13 @@ public:
         return true;
     }
 
-    // =====================================================
-    //  ✅ Fixed header read (uses open stream)
-    // =====================================================
     bool readHeader(OMNIHeader& outHeader) {
-        if (!file.is_open()) {
+        if (fd < 0) {
             cerr << "❌ Error: .omni file not open while reading header.\n";
             return false;
         }
 
-        file.clear();                      // clear flags (EOF etc.)
-        file.seekg(0, ios::beg);           // go to start
-        file.read(reinterpret_cast<char*>(&outHeader), sizeof(OMNIHeader));
-
-        if (file.gcount() != sizeof(OMNIHeader)) {
+        if (readAt(&outHeader, sizeof(OMNIHeader), 0) != sizeof(OMNIHeader)) {
             cerr << "❌ Error: Incomplete header read.\n";
             return false;
         }
@@ -123,50 +672,178 @@ public:
     //  Write and read data blocks
     // =====================================================
     bool writeFileData(uint64_t dataRegionOffset, uint32_t blockIndex, uint64_t blockSize, const vector<char>& data) {
-        if (!file.is_open()) {
+        if (fd < 0) {
             cerr << "❌ Error: .omni file not open for write.\n";
             return false;
         }
 
-        file.seekp(dataRegionOffset + (blockIndex * blockSize), ios::beg);
-        file.write(data.data(), min<uint64_t>(data.size(), blockSize));
-        file.flush();
+        if (data.size() > blockSize) {
+            cerr << "❌ " << data.size() << " bytes do not fit in one block; use writeExtent.\n";
+            return false;
+        }
+
+        if (!writeAt(data.data(), data.size(),
+                     dataRegionOffset + (static_cast<uint64_t>(blockIndex) * blockSize)))
+            return false;
+
+        // A full-block write is the new cached copy; a partial one leaves
+        // the tail unknown, so drop the entry instead.
+        if (data.size() == blockSize) cache.put(blockIndex, data.data(), data.size());
+        else cache.invalidate(blockIndex);
         cout << "💾 Wrote " << data.size() << " bytes to block #" << blockIndex << endl;
         return true;
     }
 
     bool readFileData(uint64_t dataRegionOffset, uint32_t blockIndex, uint64_t blockSize, vector<char>& outData) {
-        if (!file.is_open()) {
+        if (fd < 0) {
             cerr << "❌ Error: .omni file not open for read.\n";
             return false;
         }
 
-        outData.resize(blockSize);
-        file.seekg(dataRegionOffset + (blockIndex * blockSize), ios::beg);
-        file.read(outData.data(), blockSize);
+        if (cache.get(blockIndex, outData) && outData.size() == blockSize) {
+            cout << "📖 Read block #" << blockIndex << " from cache.\n";
+            return true;
+        }
+
+        outData.assign(blockSize, 0);
+        readAt(outData.data(), blockSize, dataRegionOffset + (static_cast<uint64_t>(blockIndex) * blockSize));
+        cache.put(blockIndex, outData.data(), outData.size());
         cout << "📖 Read block #" << blockIndex << " from .omni file.\n";
         return true;
     }
 
+    // =====================================================
+    //  Extent I/O: one sequential transfer per contiguous run
+    // =====================================================
+    bool writeExtent(uint64_t dataRegionOffset, const Extent& e, uint64_t blockSize,
+                     const char* data, size_t len) {
+        if (fd < 0) {
+            cerr << "❌ Error: .omni file not open for write.\n";
+            return false;
+        }
+
+        const uint64_t runBytes = static_cast<uint64_t>(e.count) * blockSize;
+        if (len > runBytes) return false;
+
+        const uint64_t off = dataRegionOffset + static_cast<uint64_t>(e.start) * blockSize;
+        if (!writeAt(data, len, off)) return false;
+
+        // Zero the slack in the last block so stale bytes never read back.
+        if (len < runBytes) {
+            vector<char> zeros(runBytes - len, 0);
+            if (!writeAt(zeros.data(), zeros.size(), off + len)) return false;
+        }
+        cache.invalidateRange(e.start, e.count);
+
+        cout << "💾 Wrote " << len << " bytes to blocks #" << e.start
+             << "-" << e.start + e.count - 1 << endl;
+        return true;
+    }
+
+    bool readExtent(uint64_t dataRegionOffset, const Extent& e, uint64_t blockSize,
+                    char* out, size_t len) {
+        if (fd < 0) {
+            cerr << "❌ Error: .omni file not open for read.\n";
+            return false;
+        }
+
+        len = min<uint64_t>(len, static_cast<uint64_t>(e.count) * blockSize);
+
+        // Single-block files are the hot set; serve them through the cache.
+        // Longer runs are read straight from disk in one transfer.
+        if (e.count == 1 && cache.enabled()) {
+            vector<char> block;
+            if (!readFileData(dataRegionOffset, e.start, blockSize, block)) return false;
+            memcpy(out, block.data(), len);
+            return true;
+        }
+
+        readAt(out, len, dataRegionOffset + static_cast<uint64_t>(e.start) * blockSize);
+        return true;
+    }
+
+    bool writeExtentMap(uint64_t dataRegionOffset, uint32_t mapBlock, uint64_t blockSize,
+                        const vector<Extent>& extents) {
+        vector<char> buf(blockSize, 0);
+        if (sizeof(ExtentMapHeader) + extents.size() * sizeof(Extent) > blockSize) return false;
+
+        ExtentMapHeader mh{};
+        memcpy(mh.magic, "EXTM", 4);
+        mh.count = static_cast<uint32_t>(extents.size());
+        memcpy(buf.data(), &mh, sizeof(mh));
+        memcpy(buf.data() + sizeof(mh), extents.data(), extents.size() * sizeof(Extent));
+        return writeFileData(dataRegionOffset, mapBlock, blockSize, buf);
+    }
+
+    bool readExtentMap(uint64_t dataRegionOffset, uint32_t mapBlock, uint64_t blockSize,
+                       vector<Extent>& extents) {
+        vector<char> buf;
+        if (!readFileData(dataRegionOffset, mapBlock, blockSize, buf)) return false;
+
+        ExtentMapHeader mh{};
+        memcpy(&mh, buf.data(), sizeof(mh));
+        if (memcmp(mh.magic, "EXTM", 4) != 0 ||
+            sizeof(mh) + static_cast<uint64_t>(mh.count) * sizeof(Extent) > blockSize) {
+            cerr << "❌ Block #" << mapBlock << " is not an extent map.\n";
+            return false;
+        }
+        extents.resize(mh.count);
+        memcpy(extents.data(), buf.data() + sizeof(mh), mh.count * sizeof(Extent));
+        return true;
+    }
+
+    // =====================================================
+    //  Relocation (defragmenter). Silent: runs off the request threads.
+    // =====================================================
+    // Copies count blocks from src to dst inside the data region.
+    bool copyBlocks(uint64_t dataRegionOffset, uint32_t src, uint32_t dst, uint32_t count,
+                    uint64_t blockSize) {
+        if (fd < 0) return false;
+        const size_t len = static_cast<size_t>(count) * blockSize;
+        vector<char> buf(len);
+        if (readAt(buf.data(), len, dataRegionOffset + static_cast<uint64_t>(src) * blockSize) != len)
+            return false;
+        if (!writeAt(buf.data(), len, dataRegionOffset + static_cast<uint64_t>(dst) * blockSize))
+            return false;
+        cache.invalidateRange(dst, count);
+        return true;
+    }
+
+    // Points every version block whose data root is `from` at `to`.
+    // Returns how many were rewritten.
+    uint32_t rewriteVersionRoots(uint64_t offset, const Extent& from, const Extent& to) {
+        if (fd < 0) return 0;
+        vector<VersionBlock> raw(256, VersionBlock());
+        size_t got = readAt(raw.data(), raw.size() * sizeof(VersionBlock), offset) / sizeof(VersionBlock);
+        uint32_t n = 0;
+        for (size_t i = 0; i < got; ++i) {
+            VersionBlock& vb = raw[i];
+            if (vb.filePath[0] == '\0' || vb.startBlock != from.start || vb.blockCount != from.count)
+                continue;
+            vb.startBlock = to.start;
+            vb.blockCount = to.count;
+            if (writeAt(&vb, sizeof(VersionBlock), offset + i * sizeof(VersionBlock))) ++n;
+        }
+        return n;
+    }
+
+    // Makes every write so far durable, journaled or not.
+    bool flushToDisk() { return fd >= 0 && flushHome(); }
+
     // =====================================================
     //  Write and read user table
     // =====================================================
     bool writeUsers(const vector<UserInfo>& users, uint64_t offset) {
-        if (!file.is_open()) return false;
-        file.seekp(offset, ios::beg);
-        for (const auto& u : users)
-            file.write(reinterpret_cast<const char*>(&u), sizeof(UserInfo));
-        file.flush();
+        if (fd < 0) return false;
+        if (!writeAt(users.data(), users.size() * sizeof(UserInfo), offset)) return false;
         cout << "👤 User table written successfully.\n";
         return true;
     }
 
     bool readUsers(vector<UserInfo>& users, uint64_t offset, uint32_t count) {
-        if (!file.is_open()) return false;
-        users.resize(count);
-        file.seekg(offset, ios::beg);
-        for (uint32_t i = 0; i < count; ++i)
-            file.read(reinterpret_cast<char*>(&users[i]), sizeof(UserInfo));
+        if (fd < 0) return false;
+        users.assign(count, UserInfo());
+        readAt(users.data(), count * sizeof(UserInfo), offset);
         cout << "👤 User table read successfully.\n";
         return true;
     }
@@ -174,73 +851,155 @@ public:
     // =====================================================
     //  Write and read free map
     // =====================================================
-    bool writeFreeMap(const vector<bool>& freeMap, uint64_t offset) {
-        if (!file.is_open()) return false;
-        file.seekp(offset, ios::beg);
-        for (bool bit : freeMap) {
-            char val = bit ? 1 : 0;
-            file.write(&val, 1);
-        }
-        file.flush();
+    // Packed free map: the whole bitmap in one write.
+    bool writeFreeMapWords(const vector<uint64_t>& words, uint64_t offset) {
+        if (fd < 0) return false;
+        if (!writeAt(words.data(), words.size() * sizeof(uint64_t), offset)) return false;
         cout << "🧱 Free space map written.\n";
         return true;
     }
 
-    bool readFreeMap(vector<bool>& freeMap, uint64_t offset, uint32_t count) {
-        if (!file.is_open()) return false;
-        freeMap.clear();
-        file.seekg(offset, ios::beg);
-        for (uint32_t i = 0; i < count; ++i) {
-            char val;
-            file.read(&val, 1);
-            freeMap.push_back(val);
+    // Rewrites only the given words (ascending); adjacent words coalesce.
+    bool writeFreeMapWords(const vector<uint64_t>& words, const vector<uint32_t>& dirty, uint64_t offset) {
+        if (fd < 0) return false;
+        size_t i = 0;
+        while (i < dirty.size()) {
+            size_t j = i + 1;
+            while (j < dirty.size() && dirty[j] == dirty[j - 1] + 1) ++j;
+            const uint32_t first = dirty[i];
+            if (!writeAt(&words[first], (j - i) * sizeof(uint64_t),
+                         offset + static_cast<uint64_t>(first) * sizeof(uint64_t)))
+                return false;
+            i = j;
         }
+        cout << "🧱 Free space map written (" << dirty.size() << " word(s)).\n";
+        return true;
+    }
+
+    bool readFreeMapWords(vector<uint64_t>& words, uint64_t offset, uint32_t totalBlocks) {
+        if (fd < 0) return false;
+        words.assign((static_cast<size_t>(totalBlocks) + 63) / 64, 0);
+        readAt(words.data(), words.size() * sizeof(uint64_t), offset);
         cout << "🧱 Free space map read.\n";
         return true;
     }
 
+    // Legacy one-byte-per-block map, read once when upgrading a container.
+    bool readFreeMap(vector<bool>& freeMap, uint64_t offset, uint32_t count) {
+        if (fd < 0) return false;
+        vector<char> bytes(count, 0);
+        readAt(bytes.data(), bytes.size(), offset);
+        freeMap.assign(bytes.begin(), bytes.end());
+        cout << "🧱 Free space map read (legacy byte map).\n";
+        return true;
+    }
+
     // =====================================================
     //  Directory Metadata
     // =====================================================
     bool writeFileEntries(const vector<FileEntry>& entries, uint64_t offset) {
-        if (!file.is_open()) return false;
-        file.seekp(offset, ios::beg);
-        for (const auto& e : entries)
-            file.write(reinterpret_cast<const char*>(&e), sizeof(FileEntry));
-        file.flush();
+        if (fd < 0) return false;
+        if (!writeAt(entries.data(), entries.size() * sizeof(FileEntry), offset)) return false;
         cout << "📂 Directory metadata written successfully.\n";
         return true;
     }
 
+    // Writes individual FileEntry slots (sorted by slot). offsetOf maps a
+    // slot to its position on disk; slots that are adjacent there are
+    // coalesced, so a run of changed entries costs one write.
+    template <typename OffsetOf>
+    bool writeFileEntrySlots(const vector<pair<uint32_t, FileEntry>>& slots, OffsetOf offsetOf) {
+        if (fd < 0) return false;
+        size_t i = 0;
+        vector<FileEntry> run;
+        while (i < slots.size()) {
+            const uint64_t start = offsetOf(slots[i].first);
+            run.clear();
+            do {
+                run.push_back(slots[i++].second);
+            } while (i < slots.size() && slots[i].first == slots[i - 1].first + 1 &&
+                     offsetOf(slots[i].first) == start + run.size() * sizeof(FileEntry));
+            if (!writeAt(run.data(), run.size() * sizeof(FileEntry), start)) return false;
+        }
+        cout << "📂 Directory metadata written successfully (" << slots.size() << " slot(s)).\n";
+        return true;
+    }
+
+    bool writeFileEntrySlots(const vector<pair<uint32_t, FileEntry>>& slots, uint64_t offset) {
+        return writeFileEntrySlots(slots, [offset](uint32_t slot) {
+            return offset + static_cast<uint64_t>(slot) * sizeof(FileEntry);
+        });
+    }
+
     bool readFileEntries(vector<FileEntry>& entries, uint64_t offset, uint32_t count) {
-        if (!file.is_open()) return false;
-        entries.resize(count);
-        file.seekg(offset, ios::beg);
-        for (uint32_t i = 0; i < count; ++i)
-            file.read(reinterpret_cast<char*>(&entries[i]), sizeof(FileEntry));
+        if (fd < 0) return false;
+        entries.assign(count, FileEntry());
+        readAt(entries.data(), count * sizeof(FileEntry), offset);
         cout << "📂 Directory metadata read successfully.\n";
         return true;
     }
 
+    // A run of slots straight into dst, silently; safe to call from
+    // several threads at once (loadSystem reads the table in pieces).
+    bool readFileEntries(FileEntry* dst, uint64_t offset, size_t count) {
+        if (fd < 0) return false;
+        const size_t len = count * sizeof(FileEntry);
+        return readAt(dst, len, offset) == len;
+    }
+
+    // One slot, silently (path index lookups read one per component).
+    bool readFileEntry(FileEntry& entry, uint64_t offset) {
+        if (fd < 0) return false;
+        return readAt(&entry, sizeof(FileEntry), offset) == sizeof(FileEntry);
+    }
+
+    bool writeMetaSegmentHeader(const MetaSegmentHeader& seg, uint64_t offset) {
+        if (fd < 0) return false;
+        return writeAt(&seg, sizeof(MetaSegmentHeader), offset);
+    }
+
+    bool readMetaSegmentHeader(MetaSegmentHeader& seg, uint64_t offset) {
+        if (fd < 0) return false;
+        if (readAt(&seg, sizeof(MetaSegmentHeader), offset) != sizeof(MetaSegmentHeader)) return false;
+        return memcmp(seg.magic, "OMNIMSEG", sizeof(seg.magic)) == 0;
+    }
+
+    // =====================================================
+    //  Path index pages: whole blocks through the block cache. Silent,
+    //  since a lookup touches one page per level.
+    // =====================================================
+    bool readIndexPage(uint64_t dataRegionOffset, uint32_t block, uint64_t blockSize, vector<char>& page) {
+        if (fd < 0) return false;
+        if (cache.get(block, page) && page.size() == blockSize) return true;
+        page.assign(blockSize, 0);
+        if (readAt(page.data(), blockSize, dataRegionOffset + static_cast<uint64_t>(block) * blockSize) != blockSize)
+            return false;
+        cache.put(block, page.data(), page.size());
+        return true;
+    }
+
+    bool writeIndexPage(uint64_t dataRegionOffset, uint32_t block, const vector<char>& page) {
+        if (fd < 0) return false;
+        if (!writeAt(page.data(), page.size(), dataRegionOffset + static_cast<uint64_t>(block) * page.size()))
+            return false;
+        cache.put(block, page.data(), page.size());
+        return true;
+    }
+
     // =====================================================
     //  Change Log I/O
     // =====================================================
     bool writeChangeLog(const vector<ChangeLogEntry>& log, uint64_t offset) {
-        if (!file.is_open()) return false;
-        file.seekp(offset, ios::beg);
-        for (const auto& e : log)
-            file.write(reinterpret_cast<const char*>(&e), sizeof(ChangeLogEntry));
-        file.flush();
+        if (fd < 0) return false;
+        if (!writeAt(log.data(), log.size() * sizeof(ChangeLogEntry), offset)) return false;
         cout << "🪶 Change log written successfully.\n";
         return true;
     }
 
     bool readChangeLog(vector<ChangeLogEntry>& log, uint64_t offset, uint32_t count) {
-        if (!file.is_open()) return false;
-        log.resize(count);
-        file.seekg(offset, ios::beg);
-        for (uint32_t i = 0; i < count; ++i)
-            file.read(reinterpret_cast<char*>(&log[i]), sizeof(ChangeLogEntry));
+        if (fd < 0) return false;
+        log.assign(count, ChangeLogEntry());
+        readAt(log.data(), count * sizeof(ChangeLogEntry), offset);
         cout << "🪶 Change log read successfully.\n";
         return true;
     }
@@ -249,7 +1008,7 @@ public:
     //  Version Block I/O
     // =====================================================
     bool writeVersionBlock(const VersionBlock& vb, uint64_t offset) {
-        if (!file.is_open()) {
+        if (fd < 0) {
             cerr << "❌ File not open for writing version block.\n";
             return false;
         }
@@ -259,9 +1018,7 @@ public:
             return false;
         }
 
-        file.seekp(offset, ios::beg);
-        file.write(reinterpret_cast<const char*>(&vb), sizeof(VersionBlock));
-        file.flush();
+        if (!writeAt(&vb, sizeof(VersionBlock), offset)) return false;
 
         cout << "🧾 Version block written successfully at offset "
              << offset << " (vID " << vb.versionID << ")\n";
@@ -269,19 +1026,15 @@ public:
     }
 
     bool readAllVersions(vector<VersionBlock>& list, uint64_t offset) {
-        if (!file.is_open()) return false;
-        file.seekg(offset, ios::beg);
-        VersionBlock vb{};
+        if (fd < 0) return false;
         list.clear();
 
-        for (int i = 0; i < 256; ++i) {
-            if (!file.read(reinterpret_cast<char*>(&vb), sizeof(VersionBlock)))
-                break;
-            if (strlen(vb.filePath) > 0)
-                list.push_back(vb);
-        }
+        vector<VersionBlock> raw(256, VersionBlock());
+        size_t got = readAt(raw.data(), raw.size() * sizeof(VersionBlock), offset) / sizeof(VersionBlock);
+        for (size_t i = 0; i < got; ++i)
+            if (strlen(raw[i].filePath) > 0)
+                list.push_back(raw[i]);
 
-        if (file.eof()) file.clear();
         cout << "🧾 Version blocks read successfully: " << list.size() << endl;
         return true;
     }
@@ -290,51 +1043,42 @@ public:
     //  User Table Persistence
     // =====================================================
     bool saveUsers(const vector<UserInfo>& users, uint64_t offset) {
-        if (!file.is_open()) {
+        if (fd < 0) {
             cerr << "❌ Error: File not open while saving users.\n";
             return false;
         }
 
-        file.seekp(offset, ios::beg);
-        for (const auto& user : users)
-            file.write(reinterpret_cast<const char*>(&user), sizeof(UserInfo));
-        file.flush();
+        if (!writeAt(users.data(), users.size() * sizeof(UserInfo), offset)) return false;
         cout << "✅ Saved " << users.size() << " users to .omni file.\n";
         return true;
     }
 
     bool loadUsers(vector<UserInfo>& users, uint64_t offset, uint32_t count) {
-        if (!file.is_open()) {
-            file.open(fileName, ios::in | ios::binary);
-            if (!file.is_open()) {
-                cerr << "❌ Error: Could not open file while loading users.\n";
-                return false;
-            }
+        if (fd < 0) {
+            cerr << "❌ Error: File not open while loading users.\n";
+            return false;
         }
 
-        users.resize(count);
-        file.seekg(offset, ios::beg);
-        for (uint32_t i = 0; i < count; ++i)
-            file.read(reinterpret_cast<char*>(&users[i]), sizeof(UserInfo));
+        users.assign(count, UserInfo());
+        readAt(users.data(), count * sizeof(UserInfo), offset);
 
         cout << "✅ Loaded " << count << " users from .omni file.\n";
         return true;
     }
 
-    void seekToStart() {
-        if (file.is_open()) {
-            file.seekg(0, ios::beg);
-            file.seekp(0, ios::beg);
-        }
-    }
-
     void closeFile() {
-        if (file.is_open()) {
-            file.close();
+        if (Transaction* t = txnFor()) {
+            t->depth = 1;
+            commitTransaction();
+        }
+        drainCommits();
+        journal.detach();
+        unmapContainer();
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+            directOn = false;
             cout << "🧹 Closed .omni file: " << fileName << endl;
         }
     }
-
-    // Access underlying stream safely (used by OFSCore)
-    fstream& File() { return file; }
 };
@@ -0,0 +1,159 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+
+#include "odf_types.hpp"
+#include "file_io_manager.hpp"
+
+using namespace std;
+
+static constexpr size_t K_META_READ_CHUNK = 1 << 20;   // bytes per read when loading the table
+
+// Where each FileEntry slot lives on disk.
+//
+// Slots [0, baseSlots) are the fixed table after the free map. Later
+// slots live in segments carved from the data region and chained from
+// OMNIHeader::meta_root_block (see MetaSegmentHeader). The table grows one
+// segment at a time, so capacity is bounded by free space rather than by
+// a compile-time constant. The in-memory chain keeps slot -> offset at
+// O(log segments).
+class MetadataTable {
+public:
+    struct Segment {
+        uint32_t block;
+        uint32_t blockCount;
+        uint32_t firstSlot;
+        uint32_t slotCount;
+    };
+
+private:
+    uint64_t baseOffset = 0;
+    uint32_t baseSlots = 0;
+    uint64_t dataStart = 0;
+    uint64_t blockSize = 4096;
+    vector<Segment> segments;
+
+    uint64_t segmentOffset(const Segment& g) const {
+        return dataStart + static_cast<uint64_t>(g.block) * blockSize;
+    }
+
+public:
+    void configure(uint64_t base, uint32_t slots, uint64_t dataStartOffset, uint64_t bs) {
+        baseOffset = base;
+        baseSlots = slots;
+        dataStart = dataStartOffset;
+        blockSize = bs;
+        segments.clear();
+    }
+
+    size_t capacity() const {
+        return segments.empty() ? baseSlots : segments.back().firstSlot + segments.back().slotCount;
+    }
+
+    const vector<Segment>& chain() const { return segments; }
+
+    uint32_t slotsPerSegment(uint32_t blocks) const {
+        return static_cast<uint32_t>((blocks * blockSize - sizeof(MetaSegmentHeader)) / sizeof(FileEntry));
+    }
+
+    uint64_t offsetOf(uint32_t slot) const {
+        if (slot < baseSlots) return baseOffset + static_cast<uint64_t>(slot) * sizeof(FileEntry);
+        auto it = upper_bound(segments.begin(), segments.end(), slot,
+                              [](uint32_t s, const Segment& g) { return s < g.firstSlot; });
+        const Segment& g = *(it - 1);
+        return segmentOffset(g) + sizeof(MetaSegmentHeader) +
+               static_cast<uint64_t>(slot - g.firstSlot) * sizeof(FileEntry);
+    }
+
+    // Follows count segments from rootBlock. Stops at the first bad header,
+    // keeping the segments before it.
+    bool loadChain(FileIOManager& io, uint32_t rootBlock, uint32_t count) {
+        segments.clear();
+        uint32_t block = rootBlock;
+        for (uint32_t i = 0; i < count; ++i) {
+            MetaSegmentHeader h{};
+            Segment g{block, 0, 0, 0};
+            if (!io.readMetaSegmentHeader(h, segmentOffset(g)) || h.first_slot != capacity()) {
+                cerr << "⚠️ Metadata segment " << i << " at block #" << block << " is unreadable; "
+                     << "the table ends at " << capacity() << " slots.\n";
+                return false;
+            }
+            g.blockCount = h.block_count;
+            g.firstSlot = h.first_slot;
+            g.slotCount = h.slot_count;
+            segments.push_back(g);
+            block = h.next_block;
+        }
+        return true;
+    }
+
+    // Formats blockCount blocks at block as the next segment and links the
+    // previous one to it. The caller records the root and segment count in
+    // the header, in the same transaction.
+    Segment append(FileIOManager& io, uint32_t block, uint32_t blockCount) {
+        Segment g{block, blockCount, static_cast<uint32_t>(capacity()), slotsPerSegment(blockCount)};
+
+        MetaSegmentHeader h{};
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, "OMNIMSEG", sizeof(h.magic));
+        h.block_count = g.blockCount;
+        h.first_slot = g.firstSlot;
+        h.slot_count = g.slotCount;
+        io.writeMetaSegmentHeader(h, segmentOffset(g));
+
+        if (!segments.empty()) {
+            Segment& prev = segments.back();
+            MetaSegmentHeader p{};
+            memset(&p, 0, sizeof(p));
+            memcpy(p.magic, "OMNIMSEG", sizeof(p.magic));
+            p.next_block = block;
+            p.block_count = prev.blockCount;
+            p.first_slot = prev.firstSlot;
+            p.slot_count = prev.slotCount;
+            io.writeMetaSegmentHeader(p, segmentOffset(prev));
+        }
+        segments.push_back(g);
+        return g;
+    }
+
+    // Reads slots [0, count) straight into out, in reads of up to
+    // K_META_READ_CHUNK bytes shared among `threads` readers.
+    void readSlots(FileIOManager& io, size_t count, vector<FileEntry>& out, unsigned threads = 1) {
+        count = min(count, capacity());
+        out.clear();
+        out.resize(count);
+
+        struct Piece {
+            size_t first;
+            size_t count;
+            uint64_t offset;
+        };
+        vector<Piece> pieces;
+        const size_t perPiece = K_META_READ_CHUNK / sizeof(FileEntry);
+        auto addRun = [&](size_t first, size_t n, uint64_t offset) {
+            for (size_t k = 0; k < n; k += perPiece)
+                pieces.push_back({first + k, min(perPiece, n - k), offset + k * sizeof(FileEntry)});
+        };
+        addRun(0, min<size_t>(count, baseSlots), baseOffset);
+        for (const Segment& g : segments) {
+            if (g.firstSlot >= count) break;
+            addRun(g.firstSlot, min<size_t>(g.slotCount, count - g.firstSlot),
+                   segmentOffset(g) + sizeof(MetaSegmentHeader));
+        }
+
+        atomic<size_t> next{0};
+        auto reader = [&] {
+            for (size_t i; (i = next++) < pieces.size();)
+                io.readFileEntries(out.data() + pieces[i].first, pieces[i].offset, pieces[i].count);
+        };
+        vector<thread> workers;
+        for (unsigned t = 1; t < min<size_t>(max(1u, threads), pieces.size()); ++t)
+            workers.emplace_back(reader);
+        reader();
+        for (auto& w : workers) w.join();
+    }
+};
@@ -91,8 +91,25 @@ struct OMNIHeader {
     // Reserved for Phase 2: Delta Vault 
     uint32_t file_state_storage_offset;  // Offset to file_state_storage area (4 bytes)
     uint32_t change_log_offset;       // Offset to change log (4 bytes)
+
+    uint32_t journal_offset;    // Offset to write-ahead journal, 0 = none (4 bytes)
+    uint32_t journal_size;      // Journal region size in bytes (4 bytes)
+    uint32_t feature_flags;     // OMNI_FEATURE_* bits (4 bytes)
+
+    uint32_t meta_root_block;   // First metadata segment (data block), see MetaSegmentHeader (4 bytes)
+    uint32_t meta_segments;     // Segments chained from meta_root_block (4 bytes)
+    uint32_t meta_high_water;   // Slots below this may be in use; loads read no further (4 bytes)
+
+    uint32_t index_root_block;  // Root page of the path index (data block), see IndexPageHeader (4 bytes)
+    uint32_t index_levels;      // Path index height, 0 = empty (4 bytes)
+    uint32_t index_pages;       // Blocks the path index occupies (4 bytes)
+
+    uint32_t tree_files;        // Files in the namespace, see OMNI_FEATURE_TREE_COUNTS (4 bytes)
+    uint32_t tree_directories;  // Directories, excluding root (4 bytes)
+    uint32_t tree_fragmented;   // Files stored in more than one run (4 bytes)
+    uint64_t tree_extents;      // Data runs over all files (8 bytes)
     
-    uint8_t reserved[328];      // Reserved for future use (328 bytes)
+    uint8_t reserved[272];      // Reserved for future use (272 bytes)
 
     // Default constructor
     OMNIHeader() = default;
@@ -108,6 +125,119 @@ struct OMNIHeader {
     }
 };  // Total: 512 bytes
 
+/**
+ * OMNIHeader::feature_flags
+ * PACKED_FREE_MAP: the free map holds one bit per block (1 = used) packed
+ *                  into little-endian uint64_t words; without it the map is
+ *                  one byte per block (legacy). The region stays
+ *                  total_blocks bytes long either way.
+ */
+static constexpr uint32_t OMNI_FEATURE_PACKED_FREE_MAP = 1u << 0;
+
+/**
+ * PARENT_INDEX: each FileEntry holds its own name plus parent_inode, and
+ *               entry i describes inode i + 1. The tree is rebuilt in one
+ *               linear pass, and a rename rewrites a single entry. Without
+ *               it, name holds the full path (legacy); such containers are
+ *               converted on first load.
+ */
+static constexpr uint32_t OMNI_FEATURE_PARENT_INDEX = 1u << 1;
+
+/**
+ * META_SEGMENTS: the metadata table grows past the fixed region through
+ *                segments chained from meta_root_block, and only slots
+ *                below meta_high_water are read at load. Without it the
+ *                table is the fixed region alone, read in full.
+ */
+static constexpr uint32_t OMNI_FEATURE_META_SEGMENTS = 1u << 2;
+
+/**
+ * PATH_INDEX: a B+tree over (parent_inode, name) lives in data blocks,
+ *             rooted at index_root_block, and is updated with every
+ *             metadata write. Without it (or after it was dropped) the
+ *             index is rebuilt from the tree on the next load.
+ */
+static constexpr uint32_t OMNI_FEATURE_PATH_INDEX = 1u << 3;
+
+/**
+ * TREE_COUNTS: tree_files, tree_directories, tree_fragmented and
+ *              tree_extents are kept in step with every metadata write,
+ *              so a lazy load can report namespace totals without reading
+ *              the metadata table. Set by the first full load.
+ */
+static constexpr uint32_t OMNI_FEATURE_TREE_COUNTS = 1u << 4;
+
+/**
+ * Metadata Segment
+ * A run of data blocks holding more FileEntry slots once the fixed table
+ * after the free map is full:
+ *   MetaSegmentHeader | FileEntry[slot_count]
+ * Segments form a chain starting at OMNIHeader::meta_root_block, and
+ * their slots follow on from the fixed table's.
+ */
+struct MetaSegmentHeader {
+    char magic[8];              // "OMNIMSEG"
+    uint32_t next_block;        // First block of the next segment (valid if not last)
+    uint32_t block_count;       // Blocks this segment spans
+    uint32_t first_slot;        // Slot index of the first entry
+    uint32_t slot_count;        // Entries in this segment
+    uint8_t reserved[40];       // Reserved for future use
+};  // Total: 64 bytes
+
+/**
+ * Path Index Page
+ * One block of the PATH_INDEX B+tree:
+ *   IndexPageHeader | IndexKey[count]      (leaf, level 0)
+ *   IndexPageHeader | IndexBranch[count]   (internal, level > 0)
+ * Keys order by parent inode, then name hash, then inode, so a directory's
+ * children are contiguous and a file and a directory with the same name
+ * are distinct keys. A hash match is confirmed against the FileEntry of
+ * the inode it names. In an internal page, first_child holds the keys
+ * below branch 0 and branch i's child holds keys from its key up to the
+ * next branch's.
+ */
+static constexpr uint32_t INDEX_NO_PAGE = 0xFFFFFFFF;
+
+struct IndexPageHeader {
+    char magic[4];              // "OMBT"
+    uint16_t level;             // 0 = leaf
+    uint16_t count;             // Records that follow
+    uint32_t next;              // Right sibling (leaves), INDEX_NO_PAGE = last
+    uint32_t first_child;       // Internal pages: child left of branch 0
+};  // Total: 16 bytes
+
+struct IndexKey {
+    uint32_t parent_inode;      // 0 = root
+    uint32_t inode;             // The entry this key names
+    uint64_t name_hash;         // indexNameHash() of the entry's name
+};  // Total: 16 bytes
+
+struct IndexBranch {
+    IndexKey key;               // Smallest key under child
+    uint32_t child;             // Page block
+    uint32_t pad;
+};  // Total: 24 bytes
+
+// FNV-1a; part of the on-disk format, so it must not change.
+inline uint64_t indexNameHash(const char* p, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(p[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline bool operator<(const IndexKey& a, const IndexKey& b) {
+    if (a.parent_inode != b.parent_inode) return a.parent_inode < b.parent_inode;
+    if (a.name_hash != b.name_hash) return a.name_hash < b.name_hash;
+    return a.inode < b.inode;
+}
+
+inline bool operator==(const IndexKey& a, const IndexKey& b) {
+    return a.parent_inode == b.parent_inode && a.name_hash == b.name_hash && a.inode == b.inode;
+}
+
 /**
  * User Information Structure
  * Stored in user table within .omni file
@@ -140,7 +270,7 @@ struct UserInfo {
  * Used for directory listings and file metadata
  */
 struct FileEntry {
-    char name[256];             // File/directory name (null-terminated)
+    char name[256];             // Name (null-terminated); full path without PARENT_INDEX
     uint8_t type;               // 0=file, 1=directory (EntryType)
     uint64_t size;              // Size in bytes (0 for directories)
     uint32_t permissions;       // UNIX-style permissions (e.g., 0644)
@@ -148,7 +278,10 @@ struct FileEntry {
     uint64_t modified_time;     // Last modification timestamp (Unix epoch)
     char owner[32];             // Username of owner
     uint32_t inode;             // Internal file identifier
-    uint8_t reserved[47];       // Reserved for future use
+    uint32_t start_block;       // First data block (or extent map block, see Extent)
+    uint32_t block_count;       // Blocks in that run; EXTENT_MAP_MARKER = extent map
+    uint32_t parent_inode;      // Inode of the parent directory, 0 = root (PARENT_INDEX)
+    uint8_t reserved[35];       // Reserved for future use
 
     // Default constructor
     FileEntry() = default;
@@ -157,7 +290,8 @@ struct FileEntry {
     FileEntry(const std::string& filename, EntryType entry_type, uint64_t file_size, 
               uint32_t perms, const std::string& file_owner, uint32_t file_inode)
         : type(static_cast<uint8_t>(entry_type)), size(file_size), permissions(perms), 
-          created_time(0), modified_time(0), inode(file_inode) {
+          created_time(0), modified_time(0), inode(file_inode), start_block(0), block_count(0),
+          parent_inode(0) {
         std::strncpy(name, filename.c_str(), sizeof(name) - 1);
         name[sizeof(name) - 1] = '\0';
         std::strncpy(owner, file_owner.c_str(), sizeof(owner) - 1);
@@ -172,6 +306,57 @@ struct FileEntry {
     void setType(EntryType entry_type) { type = static_cast<uint8_t>(entry_type); }
 };  // Total: 416 bytes
 
+/**
+ * Extent
+ * A contiguous run of data blocks [start, start + count).
+ *
+ * A file's data is referenced from FileEntry/VersionBlock by a single
+ * (start, count) pair:
+ *   count == 0                 -> no data
+ *   count == EXTENT_MAP_MARKER -> start is a block holding an ExtentMapHeader
+ *                                 followed by the file's Extent list
+ *   otherwise                  -> the whole file is this one run
+ */
+static constexpr uint32_t EXTENT_MAP_MARKER = 0xFFFFFFFF;
+
+struct Extent {
+    uint32_t start;
+    uint32_t count;
+};
+
+struct ExtentMapHeader {
+    char magic[4];              // "EXTM"
+    uint32_t count;             // Number of Extent records that follow
+};
+
+/**
+ * Write-ahead journal region (OMNIHeader::journal_offset / journal_size).
+ * The first block holds a JournalHeader; redo records follow, each padded
+ * to a whole block:
+ *   JournalRecordHeader | JournalWrite[write_count] | data of each write
+ * A record is valid only if its seq is checkpoint_seq + 1, + 2, ... in order
+ * and its checksum matches, so stale records left behind after a checkpoint
+ * are never replayed.
+ */
+struct JournalHeader {
+    char magic[4];              // "JRNL"
+    uint32_t version;           // 1
+    uint64_t checkpoint_seq;    // Records up to this seq are already applied
+};
+
+struct JournalRecordHeader {
+    char magic[4];              // "JREC"
+    uint32_t write_count;       // Number of JournalWrite entries
+    uint64_t seq;               // Commit sequence number
+    uint64_t length;            // Bytes after this header (unpadded)
+    uint64_t checksum;          // FNV-1a over those bytes
+};
+
+struct JournalWrite {
+    uint64_t offset;            // Home location in the container
+    uint64_t length;            // Bytes of data for this write
+};
+
 /**
  * File Metadata (Extended information)
  * Returned by get_metadata function
@@ -268,8 +453,8 @@ struct ChangeLogEntry {
 struct VersionBlock {
     char filePath[256];
     uint64_t versionID;
-    uint32_t startBlock;
-    uint32_t blockCount;
+    uint32_t startBlock;        // Same encoding as FileEntry::start_block
+    uint32_t blockCount;        // Same encoding as FileEntry::block_count
     uint64_t timestamp;
 
     VersionBlock() = default;
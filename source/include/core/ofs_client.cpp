@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include <sstream>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -25,6 +26,31 @@ string sendCommand(int sock, const string &cmd) {
     return string(buffer);
 }
 
+// Prints a streamed reply line by line as it arrives, up to its last line
+// (one starting with `done`, or an error).
+void streamCommand(int sock, const string &cmd, const string &done) {
+    string msg = cmd + "\n";
+    send(sock, msg.c_str(), msg.size(), 0);
+
+    char buffer[8192];
+    string pending;
+    while (true) {
+        ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            cout << "❌ Server closed connection\n";
+            return;
+        }
+        pending.append(buffer, n);
+        size_t nl;
+        while ((nl = pending.find('\n')) != string::npos) {
+            string line = pending.substr(0, nl + 1);
+            pending.erase(0, nl + 1);
+            cout << line;
+            if (line.compare(0, done.size(), done) == 0 || line.compare(0, 4, "ERR|") == 0) return;
+        }
+    }
+}
+
 int start_client() {
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) { perror("socket"); return 1; }
@@ -64,6 +90,15 @@ int start_client() {
              << "19. Delete file\n"
              << "20. Delete directory\n"
              << "21. Truncate (Delete & Overwrite) **NEW**\n"
+             << "22. Read file\n"
+             << "23. Defragment (Admin)\n"
+             << "24. Defragmentation status\n"
+             << "25. Open file (get handle)\n"
+             << "26. Read file by handle\n"
+             << "27. Write file by handle\n"
+             << "28. Rename / move\n"
+             << "29. Stat path (path index)\n"
+             << "30. Find (glob search)\n"
              << "0. Quit\n"
              << "=================================\n"
              << "Enter choice: ";
@@ -172,6 +207,66 @@ int start_client() {
             cout << sendCommand(sock, "TRUNCATE|" + a);
             break;
 
+        case 22:
+            cout << "File path: ";
+            getline(cin, a);
+            cout << sendCommand(sock, "READ_FILE|" + a);
+            break;
+
+        case 23:
+            cout << sendCommand(sock, "DEFRAG");
+            break;
+
+        case 24:
+            cout << sendCommand(sock, "DEFRAG|status");
+            break;
+
+        case 25:
+            cout << "File path: ";
+            getline(cin, a);
+            cout << sendCommand(sock, "OPEN|" + a);
+            break;
+
+        case 26:
+            cout << "Handle (inode:generation): ";
+            getline(cin, a);
+            cout << sendCommand(sock, "READ_HANDLE|" + a);
+            break;
+
+        case 27:
+            cout << "Handle (inode:generation): ";
+            getline(cin, a);
+            cout << "Content: ";
+            getline(cin, b);
+            cout << sendCommand(sock, "WRITE_HANDLE|" + a + "|" + b);
+            break;
+
+        case 28:
+            cout << "Current path: ";
+            getline(cin, a);
+            cout << "New path: ";
+            getline(cin, b);
+            cout << sendCommand(sock, "RENAME|" + a + "|" + b);
+            break;
+
+        case 29:
+            cout << "Path: ";
+            getline(cin, a);
+            cout << sendCommand(sock, "STAT|" + a);
+            break;
+
+        case 30:
+            cout << "Pattern (name glob, or path glob with '/'): ";
+            getline(cin, a);
+            cout << "Filters (e.g. type=f min_size=100 owner=user1 limit=50, blank = none): ";
+            getline(cin, b);
+            {
+                istringstream filters(b);
+                while (filters >> c) a += "|" + c;
+            }
+            streamCommand(sock, "FIND|" + a, "OK|FIND_DONE");
+            break;
+
         default:
             cout << "⚠ Invalid choice\n";
         }
@@ -13,6 +13,7 @@
 #include "user_manager.hpp"
 #include "session_manger.hpp"
 #include "OFSCore.hpp"
+#include "config_parser.hpp"
 
 using namespace std;
 
@@ -31,6 +32,51 @@ vector<string> split(const string& s, char delim) {
     return p;
 }
 
+FileHandle parseHandle(const string& s) {
+    FileHandle h;
+    size_t colon = s.find(':');
+    try {
+        h.inode = static_cast<uint32_t>(stoul(s.substr(0, colon)));
+        if (colon != string::npos) h.generation = static_cast<uint32_t>(stoul(s.substr(colon + 1)));
+    } catch (...) {
+        return {};
+    }
+    return h;
+}
+
+// FIND|<pattern>[|type=f|d][|min_size=N][|max_size=N][|owner=NAME][|limit=N]
+bool parseFindQuery(const vector<string>& parts, FindQuery& q, string& owner) {
+    if (parts.size() < 2 || parts[1].empty()) return false;
+    q.pattern = parts[1];
+    try {
+        for (size_t i = 2; i < parts.size(); ++i) {
+            size_t eq = parts[i].find('=');
+            if (eq == string::npos) return false;
+            string key = parts[i].substr(0, eq), value = parts[i].substr(eq + 1);
+            if (key == "type" && (value == "f" || value == "file")) q.type = 0;
+            else if (key == "type" && (value == "d" || value == "dir")) q.type = 1;
+            else if (key == "min_size") q.minSize = stoull(value);
+            else if (key == "max_size") q.maxSize = stoull(value);
+            else if (key == "limit") q.limit = stoull(value);
+            else if (key == "owner") owner = value;
+            else return false;
+        }
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+// Writes all of `data`; false once the client has gone away.
+bool sendAll(int sock, const string& data) {
+    for (size_t off = 0; off < data.size();) {
+        ssize_t n = send(sock, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        off += static_cast<size_t>(n);
+    }
+    return true;
+}
+
 void handleClient(int clientSock) {
     SessionManager session(&gUserMgr);   
     char buffer[8192];
@@ -57,7 +103,7 @@ void handleClient(int clientSock) {
 
         
         else if (cmd == "LOGIN") {
-            bool ok = session.login(parts[1], parts[2]);
+            bool ok = gOFS.withStateLock([&] { return session.login(parts[1], parts[2]); });
             if (ok) {
                 // Attach the session before any core operation
                 WITH_SESSION(&session);
@@ -87,7 +133,7 @@ void handleClient(int clientSock) {
 
         
         else if (cmd == "LOGOUT") {
-            session.logout();
+            gOFS.withStateLock([&] { session.logout(); });
             reply = "OK|LOGOUT\n";
         }
 
@@ -168,16 +214,82 @@ void handleClient(int clientSock) {
         
         else if (cmd == "READ_BLOCK") {
             WITH_SESSION(&session);
-            stringstream out;
-            streambuf *old = cout.rdbuf(out.rdbuf());
+            reply = gOFS.captureOutput([&] { gOFS.readFileContent(stoi(parts[1])); });
+        }
 
-            gOFS.readFileContent(stoi(parts[1]));
 
-            cout.rdbuf(old);
-            reply = out.str();
+        else if (cmd == "READ_FILE") {
+            WITH_SESSION(&session);
+            bool ok = false;
+            string out = gOFS.captureOutput([&] { ok = gOFS.readFile(parts[1]); });
+            reply = ok ? out : "ERR|READ_FAILED\n";
         }
 
         
+        // Handles are "<inode>:<generation>", as returned by OPEN.
+        else if (cmd == "OPEN") {
+            WITH_SESSION(&session);
+            FileHandle h = gOFS.openFile(parts[1]);
+            reply = h.valid() ? "OK|HANDLE|" + to_string(h.inode) + ":" + to_string(h.generation) + "\n"
+                              : "ERR|OPEN_FAILED\n";
+        }
+
+
+        else if (cmd == "READ_HANDLE") {
+            WITH_SESSION(&session);
+            string content;
+            bool ok = parts.size() > 1 && gOFS.readFileByHandle(parseHandle(parts[1]), content);
+            reply = ok ? content + "\n" : "ERR|READ_FAILED\n";
+        }
+
+
+        else if (cmd == "WRITE_HANDLE") {
+            WITH_SESSION(&session);
+            bool ok = parts.size() > 2 && gOFS.writeFileByHandle(parseHandle(parts[1]), parts[2]);
+            reply = ok ? "OK|FILE_WRITTEN\n" : "ERR|WRITE_FAILED\n";
+        }
+
+        
+        else if (cmd == "RENAME") {
+            WITH_SESSION(&session);
+            bool ok = parts.size() > 2 && gOFS.renamePath(parts[1], parts[2]);
+            reply = ok ? "OK|RENAMED\n" : "ERR|RENAME_FAILED\n";
+        }
+
+
+        // Served from the on-disk path index: OK|STAT|<inode>|<file|dir>|<size>.
+        else if (cmd == "STAT") {
+            WITH_SESSION(&session);
+            FileEntry e{};
+            bool ok = parts.size() > 1 && gOFS.statPath(parts[1], e);
+            reply = ok ? "OK|STAT|" + to_string(e.inode) + "|" + (e.type == 1 ? "dir" : "file") + "|" +
+                             to_string(e.size) + "\n"
+                       : "ERR|NOT_FOUND\n";
+        }
+
+
+        // Streams OK|MATCH|<path>|<file|dir>|<size>|<inode> lines as batches
+        // are found, then ends with OK|FIND_DONE|<count>.
+        else if (cmd == "FIND") {
+            WITH_SESSION(&session);
+            FindQuery query;
+            string owner;
+            size_t found = 0;
+            if (!parseFindQuery(parts, query, owner)) {
+                reply = "ERR|BAD_QUERY\n";
+            } else {
+                bool ok = gOFS.findFiles(query, owner, [&](vector<FindMatch>& batch) {
+                    string out;
+                    for (const auto& m : batch)
+                        out += "OK|MATCH|" + m.path + "|" + (m.isFile ? "file" : "dir") + "|" +
+                               to_string(m.size) + "|" + to_string(m.inode) + "\n";
+                    return sendAll(clientSock, out);
+                }, found);
+                reply = ok ? "OK|FIND_DONE|" + to_string(found) + "\n" : "ERR|FIND_FAILED\n";
+            }
+        }
+
+
         else if (cmd == "CREATE_DIR") {
             WITH_SESSION(&session);
             gOFS.createDirectory(parts[1]);
@@ -194,49 +306,47 @@ void handleClient(int clientSock) {
 
         else if (cmd == "LIST_MY_FILES") {
             WITH_SESSION(&session);
-            stringstream out;
-            streambuf *old = cout.rdbuf(out.rdbuf());
-
-            gOFS.listMyFiles();
-
-            cout.rdbuf(old);
-            reply = out.str();
+            reply = gOFS.captureOutput([&] { gOFS.listMyFiles(); });
         }
 
 
         else if (cmd == "LIST_ALL_FILES") {
             WITH_SESSION(&session);
-            stringstream out;
-            streambuf *old = cout.rdbuf(out.rdbuf());
-
-            gOFS.listAllFiles();
-
-            cout.rdbuf(old);
-            reply = out.str();
+            reply = gOFS.captureOutput([&] { gOFS.listAllFiles(); });
         }
 
 
         else if (cmd == "SHOW_TREE") {
             WITH_SESSION(&session);
-            stringstream out;
-            streambuf *old = cout.rdbuf(out.rdbuf());
+            reply = gOFS.captureOutput([&] { gOFS.showMyDirectoryTree(); });
+        }
 
-            gOFS.showMyDirectoryTree();
 
-            cout.rdbuf(old);
-            reply = out.str();
+        else if (cmd == "STATS") {
+            WITH_SESSION(&session);
+            reply = gOFS.captureOutput([&] { gOFS.printStats(); });
         }
 
 
-        else if (cmd == "SHOW_CHANGE_LOG") {
+        else if (cmd == "DEFRAG") {
             WITH_SESSION(&session);
-            stringstream out;
-            streambuf *old = cout.rdbuf(out.rdbuf());
+            string action = parts.size() > 1 ? parts[1] : "start";
+            if (!session.isAdminUser()) {
+                reply = "ERR|ADMIN_ONLY\n";
+            } else if (action == "status") {
+                reply = gOFS.captureOutput([&] { gOFS.printDefragStatus(); });
+            } else if (action == "stop") {
+                gOFS.stopDefrag();
+                reply = "OK|DEFRAG_STOPPED\n";
+            } else {
+                reply = gOFS.startDefrag() ? "OK|DEFRAG_STARTED\n" : "ERR|DEFRAG_NOT_STARTED\n";
+            }
+        }
 
-            gOFS.showChangeLog();
 
-            cout.rdbuf(old);
-            reply = out.str();
+        else if (cmd == "SHOW_CHANGE_LOG") {
+            WITH_SESSION(&session);
+            reply = gOFS.captureOutput([&] { gOFS.showChangeLog(); });
         }
 
         else if (cmd == "WRITE_FILE") {
@@ -289,6 +399,27 @@ int start_server() {
     cout << "🚀 OFS SERVER running on port " << SERVER_PORT << "\n";
 
 
+    ConfigParser config;
+    config.load("compiled/default.uconf");
+    const string ioMode = config.get("io.mode", "pread");
+    if (ioMode == "mmap") {
+        gOFS.setIOMode(IOMode::MMAP);
+        cout << "🗺️ I/O mode: mmap\n";
+    } else if (ioMode == "direct") {
+        gOFS.setIOMode(IOMode::DIRECT);
+        cout << "🎯 I/O mode: direct\n";
+    }
+    gOFS.setBlockCacheSize(config.getInt("cache.block_cache_blocks", 4096));
+    gOFS.setDentryCacheSize(config.getInt("cache.dentry_cache_entries", 4096));
+    gOFS.setLoadThreads(static_cast<unsigned>(config.getInt("startup.load_threads", 0)));
+    gOFS.setSearchThreads(static_cast<unsigned>(config.getInt("search.threads", 0)));
+    if (config.get("startup.namespace", "eager") == "lazy") {
+        gOFS.setLazyLoad(true, config.getInt("startup.resident_nodes", 1000000));
+        cout << "💤 Namespace: lazy\n";
+    }
+    if (config.get("io.engine", "sync") == "io_uring")
+        gOFS.enableAsyncIO();
+
     {
         SessionManager boot(&gUserMgr);
         WITH_SESSION(&boot);
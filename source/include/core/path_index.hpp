@@ -0,0 +1,346 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "odf_types.hpp"
+#include "file_io_manager.hpp"
+#include "../../data_structures/free_space.hpp"
+
+using namespace std;
+
+// On-disk B+tree over (parent inode, name) (OMNI_FEATURE_PATH_INDEX).
+//
+// Each page is one data block, read through the block cache, so resolving
+// a name costs one page per level: with 255 keys per leaf and 170 branches
+// per internal page, a million entries fit in three levels, and a cold
+// lookup reads those pages plus the matching FileEntry instead of the
+// whole metadata table. Pages come one block at a time from the top of
+// the data region, away from file data. A delete only removes its key;
+// pages are not merged, and the next rebuild compacts them.
+class PathIndex {
+    FileIOManager* io = nullptr;
+    FreeSpace* space = nullptr;
+    uint64_t dataStart = 0;
+    uint64_t blockSize = 4096;
+    uint32_t rootBlock = INDEX_NO_PAGE;
+    uint32_t levels = 0;
+    uint32_t pages = 0;
+    uint64_t pageReads = 0;
+
+    struct Step {
+        uint32_t block;
+        vector<char> page;
+    };
+
+    static IndexPageHeader& head(vector<char>& p) { return *reinterpret_cast<IndexPageHeader*>(p.data()); }
+    static IndexKey* keys(vector<char>& p) { return reinterpret_cast<IndexKey*>(p.data() + sizeof(IndexPageHeader)); }
+    static IndexBranch* branches(vector<char>& p) {
+        return reinterpret_cast<IndexBranch*>(p.data() + sizeof(IndexPageHeader));
+    }
+    static bool branchBefore(const IndexKey& k, const IndexBranch& b) { return k < b.key; }
+
+    size_t leafCapacity() const { return (blockSize - sizeof(IndexPageHeader)) / sizeof(IndexKey); }
+    size_t branchCapacity() const { return (blockSize - sizeof(IndexPageHeader)) / sizeof(IndexBranch); }
+
+    vector<char> blankPage(uint16_t level) const {
+        vector<char> p(blockSize, 0);
+        IndexPageHeader& h = head(p);
+        memcpy(h.magic, "OMBT", sizeof(h.magic));
+        h.level = level;
+        h.next = INDEX_NO_PAGE;
+        h.first_child = INDEX_NO_PAGE;
+        return p;
+    }
+
+    bool readPage(uint32_t block, vector<char>& p) {
+        ++pageReads;
+        if (!io->readIndexPage(dataStart, block, blockSize, p)) return false;
+        return memcmp(head(p).magic, "OMBT", sizeof(head(p).magic)) == 0;
+    }
+
+    bool writePage(uint32_t block, const vector<char>& p) { return io->writeIndexPage(dataStart, block, p); }
+
+    bool allocPage(uint32_t& block) {
+        int b = space->allocateHighBlock();
+        if (b < 0) return false;
+        block = static_cast<uint32_t>(b);
+        ++pages;
+        return true;
+    }
+
+    void freePage(uint32_t block) {
+        space->freeBlock(static_cast<int>(block));
+        io->blockCache().invalidate(block);
+        --pages;
+    }
+
+    // Allocates n pages, or none.
+    bool allocPages(size_t n, vector<uint32_t>& out) {
+        out.assign(n, INDEX_NO_PAGE);
+        for (size_t i = 0; i < n; ++i) {
+            if (allocPage(out[i])) continue;
+            for (size_t j = 0; j < i; ++j) freePage(out[j]);
+            return false;
+        }
+        return true;
+    }
+
+    // Root-to-leaf pages covering key.
+    bool descend(const IndexKey& key, vector<Step>& path) {
+        path.clear();
+        uint32_t block = rootBlock;
+        for (uint32_t l = levels; l > 0; --l) {
+            path.push_back({block, {}});
+            vector<char>& p = path.back().page;
+            if (!readPage(block, p) || head(p).level != l - 1) {
+                cerr << "❌ Path index page #" << block << " is damaged.\n";
+                return false;
+            }
+            if (l == 1) break;
+            IndexBranch* b = branches(p);
+            IndexBranch* it = upper_bound(b, b + head(p).count, key, branchBefore);
+            block = it == b ? head(p).first_child : (it - 1)->child;
+        }
+        return true;
+    }
+
+    // Inodes of the keys from lo onwards, along the leaf chain, while
+    // match(key) holds.
+    template <typename Match>
+    bool scan(const IndexKey& lo, vector<uint32_t>& out, Match match) {
+        out.clear();
+        if (levels == 0) return true;
+        vector<Step> path;
+        if (!descend(lo, path)) return false;
+        vector<char> page = move(path.back().page);
+        for (;;) {
+            IndexKey* k = keys(page);
+            IndexKey* end = k + head(page).count;
+            for (IndexKey* it = lower_bound(k, end, lo); it != end; ++it) {
+                if (!match(*it)) return true;
+                out.push_back(it->inode);
+            }
+            const uint32_t next = head(page).next;
+            if (next == INDEX_NO_PAGE) return true;
+            if (!readPage(next, page)) return false;
+        }
+    }
+
+public:
+    void configure(FileIOManager* fileIO, FreeSpace* freeSpace, uint64_t dataStartOffset, uint64_t bs) {
+        io = fileIO;
+        space = freeSpace;
+        dataStart = dataStartOffset;
+        blockSize = bs;
+        attach(INDEX_NO_PAGE, 0, 0);
+    }
+
+    // Adopts an index already on disk (from OMNIHeader).
+    void attach(uint32_t root, uint32_t height, uint32_t pageCount) {
+        rootBlock = height ? root : INDEX_NO_PAGE;
+        levels = height;
+        pages = pageCount;
+    }
+
+    uint32_t root() const { return rootBlock; }
+    uint32_t height() const { return levels; }
+    uint32_t pageCount() const { return pages; }
+    uint64_t pageReadCount() const { return pageReads; }
+
+    // Adds key (a no-op if present). False if a page could not be read or
+    // allocated; the index is then incomplete and should be dropped.
+    bool insert(const IndexKey& key) {
+        if (levels == 0) {
+            uint32_t block;
+            if (!allocPage(block)) return false;
+            vector<char> p = blankPage(0);
+            keys(p)[0] = key;
+            head(p).count = 1;
+            if (!writePage(block, p)) return false;
+            rootBlock = block;
+            levels = 1;
+            return true;
+        }
+
+        vector<Step> path;
+        if (!descend(key, path)) return false;
+        vector<char>& leaf = path.back().page;
+        IndexKey* k = keys(leaf);
+        const size_t n = head(leaf).count;
+        IndexKey* pos = lower_bound(k, k + n, key);
+        if (pos != k + n && *pos == key) return true;
+
+        if (n < leafCapacity()) {
+            memmove(pos + 1, pos, (k + n - pos) * sizeof(IndexKey));
+            *pos = key;
+            head(leaf).count = static_cast<uint16_t>(n + 1);
+            return writePage(path.back().block, leaf);
+        }
+
+        // Every full page on the path splits, and a full root adds a level;
+        // take all the pages up front so a full container changes nothing.
+        size_t splits = 0;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            const size_t cap = head(it->page).level ? branchCapacity() : leafCapacity();
+            if (head(it->page).count < cap) break;
+            ++splits;
+        }
+        vector<uint32_t> fresh;
+        if (!allocPages(splits + (splits == path.size() ? 1 : 0), fresh)) return false;
+        size_t used = 0;
+
+        vector<IndexKey> all(k, k + n);
+        all.insert(all.begin() + (pos - k), key);
+        const size_t half = all.size() / 2;
+        const uint32_t rightBlock = fresh[used++];
+        vector<char> right = blankPage(0);
+        copy(all.begin() + half, all.end(), keys(right));
+        head(right).count = static_cast<uint16_t>(all.size() - half);
+        head(right).next = head(leaf).next;
+        copy(all.begin(), all.begin() + half, k);
+        head(leaf).count = static_cast<uint16_t>(half);
+        head(leaf).next = rightBlock;
+        if (!writePage(rightBlock, right) || !writePage(path.back().block, leaf)) return false;
+
+        IndexKey sep = all[half];
+        uint32_t sepChild = rightBlock;
+        for (size_t i = path.size() - 1; i-- > 0;) {
+            vector<char>& p = path[i].page;
+            IndexBranch* b = branches(p);
+            vector<IndexBranch> bs(b, b + head(p).count);
+            bs.insert(upper_bound(bs.begin(), bs.end(), sep, branchBefore), IndexBranch{sep, sepChild, 0});
+            if (bs.size() <= branchCapacity()) {
+                copy(bs.begin(), bs.end(), b);
+                head(p).count = static_cast<uint16_t>(bs.size());
+                return writePage(path[i].block, p);
+            }
+
+            // The middle key moves up; its child becomes the new page's first.
+            const size_t mid = bs.size() / 2;
+            const uint32_t newBlock = fresh[used++];
+            vector<char> np = blankPage(head(p).level);
+            head(np).first_child = bs[mid].child;
+            copy(bs.begin() + mid + 1, bs.end(), branches(np));
+            head(np).count = static_cast<uint16_t>(bs.size() - mid - 1);
+            copy(bs.begin(), bs.begin() + mid, b);
+            head(p).count = static_cast<uint16_t>(mid);
+            if (!writePage(newBlock, np) || !writePage(path[i].block, p)) return false;
+            sep = bs[mid].key;
+            sepChild = newBlock;
+        }
+
+        const uint32_t newRoot = fresh[used++];
+        vector<char> r = blankPage(static_cast<uint16_t>(levels));
+        head(r).first_child = rootBlock;
+        branches(r)[0] = IndexBranch{sep, sepChild, 0};
+        head(r).count = 1;
+        if (!writePage(newRoot, r)) return false;
+        rootBlock = newRoot;
+        ++levels;
+        return true;
+    }
+
+    // Removes key if present. Separators stay, so later inserts of nearby
+    // keys land in the same leaf.
+    bool erase(const IndexKey& key) {
+        if (levels == 0) return true;
+        vector<Step> path;
+        if (!descend(key, path)) return false;
+        vector<char>& leaf = path.back().page;
+        IndexKey* k = keys(leaf);
+        const size_t n = head(leaf).count;
+        IndexKey* pos = lower_bound(k, k + n, key);
+        if (pos == k + n || !(*pos == key)) return true;
+        memmove(pos, pos + 1, (k + n - pos - 1) * sizeof(IndexKey));
+        head(leaf).count = static_cast<uint16_t>(n - 1);
+        return writePage(path.back().block, leaf);
+    }
+
+    // Inodes keyed (parent, hash), lowest first. Hash collisions are the
+    // caller's to filter against the entries.
+    bool find(uint32_t parent, uint64_t hash, vector<uint32_t>& out) {
+        return scan(IndexKey{parent, 0, hash}, out, [&](const IndexKey& k) {
+            return k.parent_inode == parent && k.name_hash == hash;
+        });
+    }
+
+    // Every inode keyed under parent: one directory's children.
+    bool children(uint32_t parent, vector<uint32_t>& out) {
+        return scan(IndexKey{parent, 0, 0}, out, [&](const IndexKey& k) { return k.parent_inode == parent; });
+    }
+
+    // Bulk load from sorted, distinct keys: leaves are packed full and each
+    // level above indexes the first keys of the one below. Pages go
+    // straight to their blocks; the caller publishes root() in the header.
+    bool build(const vector<IndexKey>& sorted) {
+        release();
+        if (sorted.empty()) return true;
+
+        vector<uint32_t> owned;
+        auto fail = [&] {
+            for (uint32_t b : owned) freePage(b);
+            attach(INDEX_NO_PAGE, 0, 0);
+            return false;
+        };
+
+        vector<pair<IndexKey, uint32_t>> level;   // first key, page
+        const size_t leafCap = leafCapacity();
+        vector<uint32_t> blocks;
+        if (!allocPages((sorted.size() + leafCap - 1) / leafCap, blocks)) return fail();
+        owned = blocks;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            const size_t from = i * leafCap;
+            const size_t count = min(leafCap, sorted.size() - from);
+            vector<char> p = blankPage(0);
+            copy(sorted.begin() + from, sorted.begin() + from + count, keys(p));
+            head(p).count = static_cast<uint16_t>(count);
+            head(p).next = i + 1 < blocks.size() ? blocks[i + 1] : INDEX_NO_PAGE;
+            if (!writePage(blocks[i], p)) return fail();
+            level.emplace_back(sorted[from], blocks[i]);
+        }
+
+        uint16_t height = 1;
+        const size_t fanout = branchCapacity() + 1;   // first_child + branches
+        while (level.size() > 1) {
+            if (!allocPages((level.size() + fanout - 1) / fanout, blocks)) return fail();
+            owned.insert(owned.end(), blocks.begin(), blocks.end());
+            vector<pair<IndexKey, uint32_t>> upper;
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                const size_t from = i * fanout;
+                const size_t to = min(from + fanout, level.size());
+                vector<char> p = blankPage(height);
+                head(p).first_child = level[from].second;
+                for (size_t j = from + 1; j < to; ++j)
+                    branches(p)[j - from - 1] = IndexBranch{level[j].first, level[j].second, 0};
+                head(p).count = static_cast<uint16_t>(to - from - 1);
+                if (!writePage(blocks[i], p)) return fail();
+                upper.emplace_back(level[from].first, blocks[i]);
+            }
+            level.swap(upper);
+            ++height;
+        }
+        rootBlock = level[0].second;
+        levels = height;
+        return true;
+    }
+
+    // Frees every page and leaves the index empty.
+    void release() {
+        vector<uint32_t> pending;
+        if (levels) pending.push_back(rootBlock);
+        vector<char> p;
+        while (!pending.empty()) {
+            const uint32_t block = pending.back();
+            pending.pop_back();
+            if (readPage(block, p) && head(p).level > 0) {
+                pending.push_back(head(p).first_child);
+                for (uint16_t i = 0; i < head(p).count; ++i)
+                    pending.push_back(branches(p)[i].child);
+            }
+            freePage(block);
+        }
+        attach(INDEX_NO_PAGE, 0, 0);
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <iostream>
+#include <cstdint>
+
+#include "../../data_structures/free_space.hpp"
+#include "../../data_structures/directory_tree.hpp"
+#include "odf_types.hpp"
+
+using namespace std;
+
+// Builds FSStats from counters that FreeSpace and DirectoryTree keep up to
+// date on every allocate/free and node insert/delete, so a snapshot is O(1)
+// no matter how large the container or the tree is.
+//
+// Two fragmentation figures are reported:
+//   free space - share of free blocks outside the largest free run; this is
+//                what limits the next contiguous allocation
+//   files      - share of files stored in more than one run; this is what
+//                costs extra seeks on read and what defrag can fix
+class StatsEngine {
+    const FreeSpace& space;
+    const DirectoryTree& tree;
+
+public:
+    StatsEngine(const FreeSpace& fs, const DirectoryTree& dt) : space(fs), tree(dt) {}
+
+    uint64_t freeBlocks() const { return static_cast<uint64_t>(space.getFreeCount()); }
+    uint64_t freeExtents() const { return space.freeExtentCount(); }
+    uint64_t largestFreeRun() const { return space.largestFreeExtent(); }
+
+    double freeSpaceFragmentation() const {
+        uint64_t free = freeBlocks();
+        return free ? (1.0 - (double)largestFreeRun() / free) * 100.0 : 0.0;
+    }
+
+    double fileFragmentation() const {
+        const TreeCounts& c = tree.counts();
+        return c.files ? 100.0 * c.fragmentedFiles / c.files : 0.0;
+    }
+
+    double averageExtentsPerFile() const {
+        const TreeCounts& c = tree.counts();
+        return c.files ? (double)c.extents / c.files : 0.0;
+    }
+
+    void snapshot(FSStats& out, uint64_t totalSize, uint64_t blockSize, uint64_t totalBlocks) const {
+        const uint64_t free = freeBlocks();
+        const TreeCounts& c = tree.counts();
+        out.total_size = totalSize;
+        out.used_space = (totalBlocks - free) * blockSize;
+        out.free_space = free * blockSize;
+        out.total_files = c.files;
+        out.total_directories = c.directories;
+        out.fragmentation = freeSpaceFragmentation();
+    }
+
+    void print() const {
+        const TreeCounts& c = tree.counts();
+        cout << "\n--- Fragmentation ---\n";
+        cout << "Free Extents: " << freeExtents()
+             << " | Largest Free Run: " << largestFreeRun() << " blocks\n";
+        cout << "Free Space Fragmentation: " << freeSpaceFragmentation() << "%\n";
+        cout << "Files: " << c.files << " | Directories: " << c.directories << "\n";
+        cout << "Fragmented Files: " << c.fragmentedFiles << " (" << fileFragmentation() << "%)"
+             << " | Avg Extents/File: " << averageExtentsPerFile() << "\n";
+    }
+};
@@ -0,0 +1,354 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+
+#include "odf_types.hpp"
+#include "aligned_buffer_pool.hpp"
+
+using namespace std;
+
+// Redo journal for the .omni container.
+//
+// A mutating operation hands its writes to append(), which stores them as
+// one record, and then waits in waitDurable() until the record is durable.
+// Only then does the caller write the data to its home location. Commits
+// that arrive while an fdatasync is in flight share the next one. The first
+// waiter becomes the leader and syncs everything appended so far, and the
+// followers just wait for it (group commit).
+//
+// When the region fills up, checkpoint() flushes the home locations and
+// bumps checkpoint_seq, which empties the journal. attach() replays every
+// valid record past the last checkpoint, so a crash between the journal
+// write and the home writes is repaired at the next load.
+class WriteAheadJournal {
+public:
+    using Write = pair<uint64_t, vector<char>>;                 // (offset, bytes)
+    using ApplyFn = function<bool(uint64_t, const char*, size_t)>;
+    using FlushFn = function<bool()>;
+
+private:
+    static constexpr uint64_t SLOT = 4096;   // header block / record padding
+
+    int fd = -1;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint64_t head = 0;              // next append position
+
+    uint64_t lastSeq = 0;           // last appended record
+    uint64_t durableSeq = 0;        // last record covered by an fdatasync
+    size_t pendingApply = 0;        // appended records not yet written home
+    bool syncing = false;
+    FlushFn flushHome;
+
+    AlignedBufferPool buffers{SLOT, SLOT};
+    mutex lock;
+    condition_variable cv;
+
+    atomic<uint64_t> commits{0};
+    atomic<uint64_t> syncs{0};
+    atomic<uint64_t> checkpoints{0};
+
+    static uint64_t alignUp(uint64_t v) { return (v + SLOT - 1) & ~(SLOT - 1); }
+
+    static uint64_t checksum(const char* p, size_t len) {
+        uint64_t h = 1469598103934665603ULL;
+        for (size_t i = 0; i < len; ++i) {
+            h ^= static_cast<unsigned char>(p[i]);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    static bool writeRaw(int fd, const char* p, size_t len, uint64_t offset) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::pwrite(fd, p + done, len - done, static_cast<off_t>(offset + done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cerr << "❌ Journal write failed at offset " << offset + done << ": " << strerror(errno) << endl;
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool readRaw(int fd, char* p, size_t len, uint64_t offset) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::pread(fd, p + done, len - done, static_cast<off_t>(offset + done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (n == 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool syncFd(int fd) {
+        if (::fdatasync(fd) != 0) {
+            cerr << "❌ fdatasync failed: " << strerror(errno) << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Header block through an aligned buffer, so it also works on O_DIRECT fds.
+    static bool writeHeaderBlock(int fd, AlignedBufferPool& pool, uint64_t offset, uint64_t checkpointSeq) {
+        auto buf = pool.acquire(SLOT);
+        if (!buf) return false;
+        memset(buf.data(), 0, SLOT);
+        JournalHeader jh{};
+        memcpy(jh.magic, "JRNL", 4);
+        jh.version = 1;
+        jh.checkpoint_seq = checkpointSeq;
+        memcpy(buf.data(), &jh, sizeof(jh));
+        return writeRaw(fd, buf.data(), SLOT, offset) && syncFd(fd);
+    }
+
+    // Caller holds `lock`. Waits for in-flight commits to reach their home
+    // locations, makes those durable, then empties the journal.
+    bool checkpointLocked(unique_lock<mutex>& lk) {
+        cv.wait(lk, [&] { return pendingApply == 0 && !syncing; });
+        if (head == start + SLOT) return true;
+
+        if (flushHome && !flushHome()) return false;
+        if (!writeHeaderBlock(fd, buffers, start, lastSeq)) return false;
+        durableSeq = lastSeq;
+        head = start + SLOT;
+        ++checkpoints;
+        return true;
+    }
+
+    // Reads and validates the record at `pos`; fills `writes` on success.
+    // Whole blocks are read into aligned buffers so O_DIRECT fds work too.
+    bool readRecord(uint64_t pos, uint64_t expectSeq, vector<Write>& writes, uint64_t& recordBytes) {
+        if (pos + SLOT > end) return false;
+        auto first = buffers.acquire(SLOT);
+        if (!first || !readRaw(fd, first.data(), SLOT, pos)) return false;
+
+        JournalRecordHeader rh{};
+        memcpy(&rh, first.data(), sizeof(rh));
+        if (memcmp(rh.magic, "JREC", 4) != 0 || rh.seq != expectSeq) return false;
+
+        recordBytes = alignUp(sizeof(rh) + rh.length);
+        if (pos + recordBytes > end) return false;
+
+        auto whole = buffers.acquire(recordBytes);
+        if (!whole) return false;
+        memcpy(whole.data(), first.data(), SLOT);
+        if (recordBytes > SLOT && !readRaw(fd, whole.data() + SLOT, recordBytes - SLOT, pos + SLOT))
+            return false;
+
+        const char* body = whole.data() + sizeof(rh);
+        if (checksum(body, rh.length) != rh.checksum) return false;
+
+        const uint64_t dirBytes = static_cast<uint64_t>(rh.write_count) * sizeof(JournalWrite);
+        if (dirBytes > rh.length) return false;
+        const JournalWrite* dir = reinterpret_cast<const JournalWrite*>(body);
+        uint64_t dataPos = dirBytes;
+
+        writes.clear();
+        for (uint32_t i = 0; i < rh.write_count; ++i) {
+            if (dataPos + dir[i].length > rh.length) return false;
+            const char* p = body + dataPos;
+            writes.emplace_back(dir[i].offset, vector<char>(p, p + dir[i].length));
+            dataPos += dir[i].length;
+        }
+        return true;
+    }
+
+public:
+    WriteAheadJournal() = default;
+    WriteAheadJournal(const WriteAheadJournal&) = delete;
+    WriteAheadJournal& operator=(const WriteAheadJournal&) = delete;
+
+    // Largest record that fits: the region minus its header block.
+    static uint64_t capacity(uint64_t regionSize) { return regionSize > SLOT ? regionSize - SLOT : 0; }
+
+    // Writes an empty journal header (called by format()).
+    static bool format(int fd, uint64_t offset, uint64_t size) {
+        if (fd < 0 || offset % SLOT != 0 || size < 2 * SLOT) {
+            cerr << "❌ Invalid journal region (" << offset << ", " << size << ").\n";
+            return false;
+        }
+        AlignedBufferPool pool{SLOT, SLOT, 1};
+        if (!writeHeaderBlock(fd, pool, offset, 0)) return false;
+        cout << "📓 Journal initialized at offset " << offset << " (" << size / 1024 << " KB)\n";
+        return true;
+    }
+
+    bool active() const { return fd >= 0; }
+
+    // Opens the journal at [offset, offset+size) and replays any committed
+    // records that were not checkpointed.
+    bool attach(int file, uint64_t offset, uint64_t size, FlushFn flush, const ApplyFn& apply) {
+        unique_lock<mutex> lk(lock);
+        fd = -1;
+        if (file < 0 || offset % SLOT != 0 || size < 2 * SLOT) return false;
+
+        auto buf = buffers.acquire(SLOT);
+        if (!buf || !readRaw(file, buf.data(), SLOT, offset)) {
+            cerr << "❌ Could not read journal header.\n";
+            return false;
+        }
+        JournalHeader jh{};
+        memcpy(&jh, buf.data(), sizeof(jh));
+        if (memcmp(jh.magic, "JRNL", 4) != 0) {
+            cerr << "⚠️ Journal header missing, reinitializing journal.\n";
+            jh.checkpoint_seq = 0;
+            if (!writeHeaderBlock(file, buffers, offset, 0)) return false;
+        }
+
+        fd = file;
+        start = offset;
+        end = offset + size;
+        flushHome = move(flush);
+
+        // Redo every record past the checkpoint, in order.
+        uint64_t pos = start + SLOT;
+        uint64_t seq = jh.checkpoint_seq;
+        vector<Write> writes;
+        uint64_t recordBytes = 0;
+        size_t replayed = 0;
+        while (readRecord(pos, seq + 1, writes, recordBytes)) {
+            for (const auto& w : writes)
+                apply(w.first, w.second.data(), w.second.size());
+            pos += recordBytes;
+            ++seq;
+            ++replayed;
+        }
+
+        lastSeq = durableSeq = seq;
+        pendingApply = 0;
+        syncing = false;
+        head = pos;
+        if (replayed > 0) {
+            cout << "📓 Replayed " << replayed << " journal record(s).\n";
+            if (!checkpointLocked(lk)) return false;
+        } else {
+            head = start + SLOT;
+        }
+        return true;
+    }
+
+    // Checkpoints so nothing is replayed over later writes, then detaches.
+    void detach() {
+        if (fd < 0) return;
+        {
+            unique_lock<mutex> lk(lock);
+            checkpointLocked(lk);
+        }
+        fd = -1;
+        flushHome = nullptr;
+    }
+
+    bool empty() {
+        lock_guard<mutex> g(lock);
+        return fd < 0 || head == start + SLOT;
+    }
+
+    bool checkpoint() {
+        unique_lock<mutex> lk(lock);
+        if (fd < 0) return true;
+        return checkpointLocked(lk);
+    }
+
+    // Appends `writes` as one record and returns its sequence number. The
+    // caller must then waitDurable(seq), write them home and call
+    // applied(seq). Returns 0 if the writes could not be journaled; the
+    // caller then writes them home and flushes itself. Oversized
+    // transactions checkpoint first, so no older record can be replayed
+    // over them.
+    uint64_t append(const vector<Write>& writes) {
+        uint64_t bodyBytes = writes.size() * sizeof(JournalWrite);
+        for (const auto& w : writes) bodyBytes += w.second.size();
+        const uint64_t recordBytes = alignUp(sizeof(JournalRecordHeader) + bodyBytes);
+
+        unique_lock<mutex> lk(lock);
+        if (fd < 0) return 0;
+        if (recordBytes > capacity(end - start)) {
+            cerr << "⚠️ Transaction of " << recordBytes << " bytes exceeds the journal, writing unjournaled.\n";
+            checkpointLocked(lk);
+            return 0;
+        }
+        if (head + recordBytes > end && !checkpointLocked(lk)) return 0;
+
+        auto buf = buffers.acquire(recordBytes);
+        if (!buf) return 0;
+        memset(buf.data(), 0, recordBytes);
+
+        JournalRecordHeader rh{};
+        memcpy(rh.magic, "JREC", 4);
+        rh.write_count = static_cast<uint32_t>(writes.size());
+        rh.length = bodyBytes;
+
+        char* body = buf.data() + sizeof(rh);
+        JournalWrite* dir = reinterpret_cast<JournalWrite*>(body);
+        char* data = body + writes.size() * sizeof(JournalWrite);
+        for (size_t i = 0; i < writes.size(); ++i) {
+            dir[i] = {writes[i].first, writes[i].second.size()};
+            memcpy(data, writes[i].second.data(), writes[i].second.size());
+            data += writes[i].second.size();
+        }
+        rh.checksum = checksum(body, bodyBytes);
+
+        const uint64_t seq = lastSeq + 1;
+        rh.seq = seq;
+        memcpy(buf.data(), &rh, sizeof(rh));
+        if (!writeRaw(fd, buf.data(), recordBytes, head)) return 0;
+
+        lastSeq = seq;
+        head += recordBytes;
+        ++pendingApply;
+        ++commits;
+        return seq;
+    }
+
+    // Blocks until record `seq` is durable. Group commit: one waiter syncs
+    // for everyone appended so far. On false the record may not survive a
+    // crash, so the caller must flush the home writes itself.
+    bool waitDurable(uint64_t seq) {
+        unique_lock<mutex> lk(lock);
+        while (durableSeq < seq) {
+            if (syncing) {
+                cv.wait(lk);
+                continue;
+            }
+            syncing = true;
+            const uint64_t target = lastSeq;
+            lk.unlock();
+            const bool ok = syncFd(fd);
+            lk.lock();
+            syncing = false;
+            ++syncs;
+            if (ok) durableSeq = max(durableSeq, target);
+            cv.notify_all();
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    // The writes of record `seq` have reached their home locations.
+    void applied(uint64_t seq) {
+        if (seq == 0) return;
+        lock_guard<mutex> g(lock);
+        if (pendingApply > 0) --pendingApply;
+        cv.notify_all();
+    }
+
+    uint64_t commitCount() const { return commits; }
+    uint64_t syncCount() const { return syncs; }
+    uint64_t checkpointCount() const { return checkpoints; }
+};